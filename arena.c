@@ -0,0 +1,101 @@
+/*
+ * Arena (bump) allocator
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "errors.h"
+#include "arena.h"
+
+/* Round a size up to the arena alignment */
+#define ALIGN_UP(x) (((x) + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1))
+
+/* Offset of the data in a block */
+#define BLOCK_HEADER_SIZE ALIGN_UP(sizeof(ArenaBlock))
+
+/*
+ * Create a block of <size> bytes of data
+ */
+static ArenaBlock *create_block(size_t size){
+    ArenaBlock *block;
+
+    block = (ArenaBlock *) malloc(BLOCK_HEADER_SIZE + size);
+    if (block == NULL)
+        raise_error("Internal error: out of memory.");
+
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+Arena *create_arena(){
+    return (Arena *) calloc(1, sizeof(Arena));
+}
+
+void *arena_alloc(Arena *arena, size_t size){
+    ArenaBlock *block;
+    char *ptr;
+
+    size = ALIGN_UP(size ? size : 1);
+
+    /* Move to the next (already allocated) blocks until one has enough room */
+    while (arena->cur != NULL && arena->cur->used + size > arena->cur->size && arena->cur->next != NULL){
+        arena->cur = arena->cur->next;
+        arena->cur->used = 0;
+    }
+
+    /* Add a new block at the end of the arena */
+    if (arena->cur == NULL || arena->cur->used + size > arena->cur->size){
+        block = create_block(size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE);
+        if (arena->cur == NULL)
+            arena->first = block;
+        else
+            arena->cur->next = block;
+        arena->cur = block;
+    }
+
+    ptr = (char *) arena->cur + BLOCK_HEADER_SIZE + arena->cur->used;
+    arena->cur->used += size;
+
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+ArenaMark arena_mark(Arena *arena){
+    ArenaMark mark;
+
+    mark.block = arena->cur;
+    mark.used = arena->cur ? arena->cur->used : 0;
+    return mark;
+}
+
+void arena_release(Arena *arena, ArenaMark mark){
+    /* The arena was empty when the mark was taken */
+    if (mark.block == NULL){
+        reset_arena(arena);
+        return;
+    }
+
+    arena->cur = mark.block;
+    arena->cur->used = mark.used;
+}
+
+void reset_arena(Arena *arena){
+    arena->cur = arena->first;
+    if (arena->cur != NULL)
+        arena->cur->used = 0;
+}
+
+void free_arena(Arena *arena){
+    ArenaBlock *block;
+
+    if (arena == NULL)
+        return;
+
+    while (arena->first != NULL){
+        block = arena->first;
+        arena->first = block->next;
+        free(block);
+    }
+    free(arena);
+}
@@ -0,0 +1,107 @@
+/*
+ * Arena (bump) allocator
+ * Memory is taken from big blocks and is never freed one allocation at a time:
+ * the whole arena (or everything allocated after a mark) is released in one shot
+ */
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_BLOCK_SIZE 65536
+#define ARENA_ALIGN 16
+
+/*
+ * Block of memory of an arena, the data follows the header
+ *
+ * Attributes:
+ * next - Next block of the arena
+ * size - Number of bytes of data in the block
+ * used - Number of bytes already allocated from the block
+ */
+typedef struct ArenaBlock{
+	struct ArenaBlock *next;
+	size_t size;
+	size_t used;
+} ArenaBlock;
+
+/*
+ * Represent an arena
+ *
+ * Attributes:
+ * first - First block of the arena
+ * cur - Block the allocations are currently taken from
+ */
+typedef struct Arena{
+	ArenaBlock *first;
+	ArenaBlock *cur;
+} Arena;
+
+/*
+ * Position in an arena, see arena_release
+ *
+ * Attributes:
+ * block - Current block when the mark was taken
+ * used - Bytes used in <block> when the mark was taken
+ */
+typedef struct ArenaMark{
+	ArenaBlock *block;
+	size_t used;
+} ArenaMark;
+
+/*
+ * Create an empty arena
+ *
+ * Return:
+ * The arena, NULL if there is no memory
+ */
+Arena *create_arena();
+
+/*
+ * Allocate zeroed memory from an arena
+ * An error is raised if there is no memory left
+ *
+ * Args:
+ * arena - The arena
+ * size - Number of bytes to allocate
+ *
+ * Return:
+ * Pointer to the allocated memory
+ */
+void *arena_alloc(Arena *arena, size_t size);
+
+/*
+ * Return the current position of an arena
+ *
+ * Args:
+ * arena - The arena
+ */
+ArenaMark arena_mark(Arena *arena);
+
+/*
+ * Release everything allocated from an arena after a mark was taken
+ * The memory is kept for the next allocations
+ *
+ * Args:
+ * arena - The arena
+ * mark - The mark
+ */
+void arena_release(Arena *arena, ArenaMark mark);
+
+/*
+ * Release everything allocated from an arena (the memory is kept for the next allocations)
+ *
+ * Args:
+ * arena - The arena
+ */
+void reset_arena(Arena *arena);
+
+/*
+ * Free an arena and all its blocks
+ *
+ * Args:
+ * arena - The arena
+ */
+void free_arena(Arena *arena);
+
+#endif
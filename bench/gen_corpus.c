@@ -0,0 +1,257 @@
+/*
+ * Generator of synthetic source files for the benchmarks
+ * Print a valid source file of the requested number of lines on the standard output
+ *
+ * Usage: gen_corpus [-l PCT] [-d PCT] [-c PCT] [-s LEN] [-x N] [-e N] [-r SEED] LINES
+ *
+ * -l PCT: percentage of code and data lines that define a label (default 30)
+ * -d PCT: percentage of data lines among the code and data lines (default 25)
+ * -c PCT: percentage of comments and blank lines (default 10)
+ * -s LEN: maximum length of the .asciz strings (default 16, at most 48)
+ * -x N: number of external labels (default 10)
+ * -e N: number of entry labels (default 10)
+ * -r SEED: seed of the generator (default 1)
+ *
+ * Branches only go back to the last code label and jumps only target code labels,
+ * so the immediates and addresses always fit in their fields.
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define ASCIZ_MAX_LEN 48
+
+/*
+ * Parameters of the generated file
+ */
+typedef struct CorpusParams{
+	long lines;
+	int label_pct;
+	int data_pct;
+	int comment_pct;
+	int asciz_len;
+	int externs_cnt;
+	int entries_cnt;
+	unsigned long seed;
+} CorpusParams;
+
+/*
+ * State of the generation
+ *
+ * Attributes:
+ * rnd - State of the random numbers generator
+ * labels_cnt - Number of labels defined so far (named L0, L1...)
+ * last_code_label - Index of the last label defined on a code line, -1 if there is none
+ * code_labels_cnt - Number of labels defined on code lines
+ * code_labels - Indexes of the labels defined on code lines
+ */
+typedef struct Corpus{
+	unsigned long rnd;
+	long labels_cnt;
+	long last_code_label;
+	long code_labels_cnt;
+	long *code_labels;
+} Corpus;
+
+/*
+ * Return a random number in [0, n) (xorshift32)
+ */
+static long random_below(Corpus *c, long n){
+    c->rnd ^= (c->rnd << 13) & 0xffffffffUL;
+    c->rnd ^= c->rnd >> 17;
+    c->rnd ^= (c->rnd << 5) & 0xffffffffUL;
+    return (long) (c->rnd % (unsigned long) n);
+}
+
+/*
+ * Return a random register
+ */
+static int random_register(Corpus *c){
+    return (int) random_below(c, 32);
+}
+
+/*
+ * Print a code line
+ */
+static void gen_code_line(Corpus *c, CorpusParams *p){
+    long target;
+
+    switch (random_below(c, 8)) {
+        case 0:
+            printf("add $%d,$%d,$%d\n", random_register(c), random_register(c), random_register(c));
+            break;
+        case 1:
+            printf("move $%d,$%d\n", random_register(c), random_register(c));
+            break;
+        case 2:
+            printf("addi $%d,%ld,$%d\n", random_register(c), random_below(c, 2001) - 1000, random_register(c));
+            break;
+        case 3:
+            printf("lw $%d,%ld,$%d\n", random_register(c), random_below(c, 64) * 4, random_register(c));
+            break;
+        case 4:
+            if (c->last_code_label >= 0){
+                printf("bne $%d,$%d,L%ld\n", random_register(c), random_register(c), c->last_code_label);
+                break;
+            }
+            printf("sub $%d,$%d,$%d\n", random_register(c), random_register(c), random_register(c));
+            break;
+        case 5:
+            if (c->code_labels_cnt > 0){
+                target = c->code_labels[random_below(c, c->code_labels_cnt)];
+                printf("%s L%ld\n", random_below(c, 2) ? "jmp" : "la", target);
+                break;
+            }
+            printf("jmp $%d\n", random_register(c));
+            break;
+        case 6:
+            if (p->externs_cnt > 0){
+                printf("call X%ld\n", random_below(c, p->externs_cnt));
+                break;
+            }
+            printf("jmp $%d\n", random_register(c));
+            break;
+        default:
+            printf("sw $%d,%ld,$%d\n", random_register(c), random_below(c, 64) * 4, random_register(c));
+            break;
+    }
+}
+
+/*
+ * Print a data line
+ */
+static void gen_data_line(Corpus *c, CorpusParams *p){
+    char str[ASCIZ_MAX_LEN + 1];
+    long i, len;
+
+    switch (random_below(c, 4)) {
+        case 0:
+            printf(".db %ld,%ld,%ld\n", random_below(c, 256) - 128, random_below(c, 256) - 128, random_below(c, 256) - 128);
+            break;
+        case 1:
+            printf(".dh %ld,%ld\n", random_below(c, 65536) - 32768, random_below(c, 65536) - 32768);
+            break;
+        case 2:
+            printf(".dw %ld\n", random_below(c, 2000000) - 1000000);
+            break;
+        default:
+            len = p->asciz_len > 0 ? random_below(c, p->asciz_len) + 1 : 0;
+            for (i = 0; i < len; i++)
+                str[i] = 'a' + random_below(c, 26);
+            str[len] = '\0';
+            printf(".asciz \"%s\"\n", str);
+            break;
+    }
+}
+
+/*
+ * Print a whole source file
+ */
+static void gen_corpus(CorpusParams *p){
+    Corpus c;
+    long i, body_lines, step, label;
+    int is_data;
+
+    c.rnd = p->seed ? p->seed : 1;
+    c.labels_cnt = c.code_labels_cnt = 0;
+    c.last_code_label = -1;
+    c.code_labels = (long *) malloc((p->lines + 1) * sizeof(long));
+    if (c.code_labels == NULL){
+        fprintf(stderr, "gen_corpus: out of memory\n");
+        exit(1);
+    }
+
+    body_lines = p->lines - p->externs_cnt - p->entries_cnt - 1;
+
+    for (i = 0; i < p->externs_cnt; i++)
+        printf(".extern X%ld\n", i);
+
+    for (i = 0; i < body_lines; i++){
+        if (random_below(&c, 100) < p->comment_pct){
+            if (random_below(&c, 2))
+                printf("; comment %ld\n", i);
+            else
+                printf("\n");
+            continue;
+        }
+
+        is_data = random_below(&c, 100) < p->data_pct;
+        label = -1;
+        if (random_below(&c, 100) < p->label_pct){
+            label = c.labels_cnt++;
+            printf("L%ld: ", label);
+        }
+
+        if (is_data)
+            gen_data_line(&c, p);
+        else{
+            gen_code_line(&c, p);
+
+            /* A branch to its own line would have a null distance, the label can only be used by the next lines */
+            if (label >= 0){
+                c.last_code_label = label;
+                c.code_labels[c.code_labels_cnt++] = label;
+            }
+        }
+    }
+    printf("stop\n");
+
+    /* Spread the entries over the defined labels */
+    if (c.labels_cnt > 0 && p->entries_cnt > 0){
+        step = c.labels_cnt / p->entries_cnt > 0 ? c.labels_cnt / p->entries_cnt : 1;
+        for (i = 0; i < p->entries_cnt && i * step < c.labels_cnt; i++)
+            printf(".entry L%ld\n", i * step);
+    }
+
+    free(c.code_labels);
+}
+
+int main(int argc, char *argv[]){
+    CorpusParams p;
+    int opt;
+
+    p.label_pct = 30;
+    p.data_pct = 25;
+    p.comment_pct = 10;
+    p.asciz_len = 16;
+    p.externs_cnt = 10;
+    p.entries_cnt = 10;
+    p.seed = 1;
+
+    while ((opt = getopt(argc, argv, "l:d:c:s:x:e:r:")) != -1){
+        switch (opt) {
+            case 'l': p.label_pct = atoi(optarg); break;
+            case 'd': p.data_pct = atoi(optarg); break;
+            case 'c': p.comment_pct = atoi(optarg); break;
+            case 's': p.asciz_len = atoi(optarg); break;
+            case 'x': p.externs_cnt = atoi(optarg); break;
+            case 'e': p.entries_cnt = atoi(optarg); break;
+            case 'r': p.seed = strtoul(optarg, NULL, 10); break;
+            default:
+                fprintf(stderr, "Usage: gen_corpus [-l PCT] [-d PCT] [-c PCT] [-s LEN] [-x N] [-e N] [-r SEED] LINES\n");
+                return 1;
+        }
+    }
+
+    if (optind >= argc){
+        fprintf(stderr, "Usage: gen_corpus [-l PCT] [-d PCT] [-c PCT] [-s LEN] [-x N] [-e N] [-r SEED] LINES\n");
+        return 1;
+    }
+    p.lines = atol(argv[optind]);
+
+    if (p.asciz_len > ASCIZ_MAX_LEN)
+        p.asciz_len = ASCIZ_MAX_LEN;
+    if (p.externs_cnt < 0)
+        p.externs_cnt = 0;
+    if (p.entries_cnt < 0)
+        p.entries_cnt = 0;
+    if (p.lines < p.externs_cnt + p.entries_cnt + 1){
+        fprintf(stderr, "gen_corpus: at least %d lines are needed\n", p.externs_cnt + p.entries_cnt + 1);
+        return 1;
+    }
+
+    gen_corpus(&p);
+    return 0;
+}
@@ -0,0 +1,212 @@
+/*
+ * Benchmark harness
+ * Run the assembler on each source file (smallest first) and report the wall time, the lines
+ * per second and the peak memory of the best run, then flag the superlinear steps
+ *
+ * Usage: run_bench [-n RUNS] ASSEMBLER FILE...
+ *
+ * -n RUNS: number of runs of each file, the fastest one is kept (default 3)
+ */
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+/* A step is superlinear if the time grows this much faster than the number of lines */
+#define SUPERLINEAR_RATIO 1.5
+/* Steps starting under this time (in seconds) are too noisy to be flagged */
+#define MIN_FLAGGED_TIME 0.01
+
+/*
+ * Result of the benchmark of a file
+ *
+ * Attributes:
+ * fname - The source file
+ * lines - Number of lines of the file
+ * wall - Wall time of the fastest run (seconds)
+ * peak_rss - Peak resident memory of the assembler (KiB)
+ * failed - True if the assembler failed on the file
+ */
+typedef struct BenchResult{
+	char *fname;
+	long lines;
+	double wall;
+	long peak_rss;
+	int failed;
+} BenchResult;
+
+/*
+ * Count the lines of a file
+ *
+ * Return:
+ * The number of lines, -1 if the file cannot be read
+ */
+static long count_lines(char *fname){
+    FILE *fp;
+    char buf[65536];
+    size_t n, i;
+    long lines;
+    int last;
+
+    fp = fopen(fname, "r");
+    if (fp == NULL)
+        return -1;
+
+    lines = 0;
+    last = '\n';
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0){
+        for (i = 0; i < n; i++)
+            if (buf[i] == '\n')
+                lines++;
+        last = buf[n - 1];
+    }
+    fclose(fp);
+
+    /* The last line may have no line break */
+    return last == '\n' ? lines : lines + 1;
+}
+
+/*
+ * Run the assembler once on a file, its output is discarded
+ *
+ * Args:
+ * assembler - Path of the assembler
+ * fname - The source file
+ * wall - Where the wall time is written (seconds)
+ * peak_rss - Where the peak resident memory is written (KiB)
+ *
+ * Return:
+ * 0 if the assembler succeeded else -1
+ */
+static int run_once(char *assembler, char *fname, double *wall, long *peak_rss){
+    struct timespec start, end;
+    struct rusage usage;
+    pid_t pid;
+    int status, null_fd;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pid = fork();
+    if (pid < 0)
+        return -1;
+
+    if (pid == 0){
+        null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd >= 0)
+            dup2(null_fd, STDOUT_FILENO);
+        execl(assembler, assembler, fname, (char *) NULL);
+        _exit(127);
+    }
+
+    if (wait4(pid, &status, 0, &usage) < 0)
+        return -1;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    *wall = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    *peak_rss = usage.ru_maxrss;
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+/*
+ * Order the results by number of lines
+ */
+static int cmp_lines(const void *a, const void *b){
+    long lines_a = ((BenchResult *) a)->lines;
+    long lines_b = ((BenchResult *) b)->lines;
+
+    return lines_a < lines_b ? -1 : lines_a > lines_b ? 1 : 0;
+}
+
+int main(int argc, char *argv[]){
+    BenchResult *results, *r, *prev;
+    char *assembler;
+    int runs, cnt, i, j, opt, superlinear_cnt;
+    double wall, ratio;
+    long peak_rss;
+
+    runs = 3;
+    while ((opt = getopt(argc, argv, "n:")) != -1){
+        if (opt == 'n')
+            runs = atoi(optarg) > 0 ? atoi(optarg) : 1;
+        else{
+            fprintf(stderr, "Usage: run_bench [-n RUNS] ASSEMBLER FILE...\n");
+            return 1;
+        }
+    }
+
+    if (argc - optind < 2){
+        fprintf(stderr, "Usage: run_bench [-n RUNS] ASSEMBLER FILE...\n");
+        return 1;
+    }
+
+    assembler = argv[optind];
+    cnt = argc - optind - 1;
+    results = (BenchResult *) calloc(cnt, sizeof(BenchResult));
+
+    for (i = 0; i < cnt; i++){
+        r = &results[i];
+        r->fname = argv[optind + 1 + i];
+        r->lines = count_lines(r->fname);
+        if (r->lines < 0){
+            fprintf(stderr, "run_bench: cannot read %s\n", r->fname);
+            return 1;
+        }
+    }
+    qsort(results, cnt, sizeof(BenchResult), cmp_lines);
+
+    printf("%-32s %10s %12s %14s %14s  %s\n", "file", "lines", "wall (s)", "lines/s", "peak RSS (MB)", "scaling");
+
+    superlinear_cnt = 0;
+    for (i = 0; i < cnt; i++){
+        r = &results[i];
+
+        /* Keep the fastest run, and the biggest peak memory */
+        for (j = 0; j < runs; j++){
+            if (run_once(assembler, r->fname, &wall, &peak_rss) != 0){
+                r->failed = 1;
+                break;
+            }
+            if (j == 0 || wall < r->wall)
+                r->wall = wall;
+            if (peak_rss > r->peak_rss)
+                r->peak_rss = peak_rss;
+        }
+
+        if (r->failed){
+            printf("%-32s %10ld %12s\n", r->fname, r->lines, "FAILED");
+            continue;
+        }
+
+        printf("%-32s %10ld %12.4f %14.0f %14.1f", r->fname, r->lines, r->wall,
+               r->wall > 0 ? r->lines / r->wall : 0.0, r->peak_rss / 1024.0);
+
+        /* Time ratio divided by lines ratio, compared to the previous file */
+        prev = i > 0 ? &results[i - 1] : NULL;
+        if (prev == NULL || prev->failed || prev->wall <= 0 || prev->lines <= 0)
+            printf("  -\n");
+        else{
+            ratio = (r->wall / prev->wall) / ((double) r->lines / prev->lines);
+            printf("  x%.2f", ratio);
+            if (ratio > SUPERLINEAR_RATIO && prev->wall >= MIN_FLAGGED_TIME){
+                printf("  SUPERLINEAR");
+                superlinear_cnt++;
+            }
+            printf("\n");
+        }
+    }
+
+    if (superlinear_cnt > 0)
+        printf("\n%d superlinear step(s): the time per line grows with the size of the file\n", superlinear_cnt);
+
+    free(results);
+    return 0;
+}
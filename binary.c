@@ -0,0 +1,100 @@
+/*
+ * Binary object files (.bin)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "errors.h"
+#include "globals.h"
+#include "binary.h"
+#include "writer.h"
+#include "context.h"
+
+/*
+ * Write a 16 bits little endian integer
+ */
+static void put_u16(unsigned char *p, unsigned long v){
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+/*
+ * Write a 32 bits little endian integer
+ */
+static void put_u32(unsigned char *p, unsigned long v){
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+void dump_binary_object(char *of, WORD_32 *code, int code_cnt, DataImage *data_img, LabelsTable *tbl, ExternalRefs *ext_refs){
+    Writer *w;
+    Label *lbl;
+    unsigned char header[BINARY_HEADER_SIZE];
+    unsigned char *code_bytes, *entries, *refs;
+    unsigned long *offsets; /* Offset of the name of each label in the strings table */
+    char *strings;
+    size_t strings_len;
+    int i, entries_cnt;
+
+    /* Strings table: names of the entry and external labels */
+    offsets = (unsigned long *) ctx_calloc(tbl->count + 1, sizeof(unsigned long));
+    strings_len = 0;
+    entries_cnt = 0;
+    for (i = 0; i < tbl->count; i++){
+        lbl = &tbl->labels[i];
+        if (lbl->is_entry || lbl->is_external){
+            offsets[i] = strings_len;
+            strings_len += strlen(get_label_name(tbl, lbl)) + 1;
+        }
+        if (lbl->is_entry)
+            entries_cnt++;
+    }
+
+    strings = (char *) ctx_calloc(strings_len + 1, sizeof(char));
+    entries = (unsigned char *) ctx_calloc(entries_cnt + 1, BINARY_RECORD_SIZE);
+    entries_cnt = 0;
+    for (i = 0; i < tbl->count; i++){
+        lbl = &tbl->labels[i];
+        if (lbl->is_entry || lbl->is_external)
+            strcpy(strings + offsets[i], get_label_name(tbl, lbl));
+
+        if (lbl->is_entry){
+            put_u32(entries + entries_cnt * BINARY_RECORD_SIZE, offsets[i]);
+            put_u32(entries + entries_cnt * BINARY_RECORD_SIZE + 4, lbl->value);
+            entries_cnt++;
+        }
+    }
+
+    /* External references table, in the order of the references */
+    refs = (unsigned char *) ctx_calloc(ext_refs->cnt + 1, BINARY_RECORD_SIZE);
+    for (i = 0; i < ext_refs->cnt; i++){
+        put_u32(refs + i * BINARY_RECORD_SIZE, offsets[ext_refs->refs[i].label]);
+        put_u32(refs + i * BINARY_RECORD_SIZE + 4, ext_refs->refs[i].addr);
+    }
+
+    /* The words become their bytes, in place */
+    code_bytes = (unsigned char *) code;
+    for (i = 0; i < code_cnt; i++)
+        put_u32(code_bytes + 4 * i, code[i]);
+
+    memset(header, 0, BINARY_HEADER_SIZE);
+    memcpy(header, BINARY_MAGIC, 4);
+    put_u16(header + 4, BINARY_VERSION);
+    put_u16(header + 6, ext_refs->grouped ? BINARY_GROUPED_EXTERNALS : 0);
+    put_u32(header + 8, 4 * code_cnt);
+    put_u32(header + 12, data_img->len);
+    put_u32(header + 16, entries_cnt);
+    put_u32(header + 20, ext_refs->cnt);
+    put_u32(header + 24, strings_len);
+
+    w = create_writer(of);
+    write_to_writer(w, (char *) header, BINARY_HEADER_SIZE);
+    write_to_writer(w, (char *) code_bytes, 4 * code_cnt);
+    write_to_writer(w, (char *) data_img->bytes, data_img->len);
+    write_to_writer(w, (char *) entries, entries_cnt * BINARY_RECORD_SIZE);
+    write_to_writer(w, (char *) refs, ext_refs->cnt * BINARY_RECORD_SIZE);
+    write_to_writer(w, strings, strings_len);
+    close_writer(w);
+}
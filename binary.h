@@ -0,0 +1,43 @@
+/*
+ * Binary object files (.bin), written alongside the text object file with --binary
+ *
+ * Layout (every number is an unsigned little endian integer):
+ * Header (32 bytes):
+ *     magic "AOBJ" (4), version (2), flags (2, see BINARY_GROUPED_EXTERNALS), code size (4), data size (4),
+ *     entries count (4), external references count (4), strings size (4), reserved (4)
+ * Code section - The encoded instructions, 4 bytes each (same byte order as the .ob file), loaded at address 100
+ * Data section - The data image, loaded right after the code
+ * Entries table - 8 bytes per entry: name offset (4), address (4)
+ * External references table - 8 bytes per reference: name offset (4), address of the instruction (4)
+ * Strings table - Null terminated names, each name of an entry or external label is stored once
+ */
+#ifndef BINARY_H
+#define BINARY_H
+
+#include "encoder.h"
+#include "labels.h"
+
+#define BINARY_SUFFIX ".bin"
+#define BINARY_MAGIC "AOBJ"
+#define BINARY_VERSION 1
+#define BINARY_HEADER_SIZE 32
+#define BINARY_RECORD_SIZE 8
+
+/* Flag of the header: the external references are grouped by label (see --group-externals) */
+#define BINARY_GROUPED_EXTERNALS 1
+
+/*
+ * Write the binary object file of an assembled source file
+ * Each section is passed to the writer in one write
+ *
+ * Args:
+ * of - Name of the binary object file
+ * code - The encoded instructions (converted in place to little endian bytes)
+ * code_cnt - Number of encoded instructions
+ * data_img - The data image
+ * tbl - The labels table
+ * ext_refs - The external references
+ */
+void dump_binary_object(char *of, WORD_32 *code, int code_cnt, DataImage *data_img, LabelsTable *tbl, ExternalRefs *ext_refs);
+
+#endif
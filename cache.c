@@ -0,0 +1,151 @@
+/*
+ * Content-addressed build cache (--cache DIR)
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "globals.h"
+#include "binary.h"
+#include "cache.h"
+#include "context.h"
+
+#define COPY_CHUNK_SIZE 65536
+#define CACHE_TMP_PREFIX ".tmp-"
+#define CACHE_OUTPUT_NAME "out"
+
+/*
+ * Suffixes of the outputs stored in an entry, the binary object file is the last one
+ */
+static char *outputs_suffixes[] = {".ob", ".ent", ".ext", BINARY_SUFFIX};
+#define OUTPUTS_CNT(with_binary) ((with_binary) ? 4 : 3)
+
+/*
+ * Build a path: <dir>/<name><suffix>, or <name><suffix> if <dir> is NULL
+ *
+ * Return:
+ * The path, allocated with ctx_calloc
+ */
+static char *join_path(char *dir, char *name, char *suffix){
+    char *path;
+
+    path = (char *) ctx_calloc((dir ? strlen(dir) : 0) + strlen(name) + strlen(suffix) + 2, sizeof(char));
+    if (dir != NULL)
+        sprintf(path, "%s/%s%s", dir, name, suffix);
+    else
+        sprintf(path, "%s%s", name, suffix);
+    return path;
+}
+
+/*
+ * Copy a file
+ *
+ * Return:
+ * False if the file cannot be copied
+ */
+static bool copy_file(char *from, char *to){
+    FILE *in, *out;
+    char buf[COPY_CHUNK_SIZE];
+    size_t n;
+    bool ok;
+
+    in = ctx_fopen(from, "rb");
+    if (in == NULL)
+        return false;
+
+    out = ctx_fopen(to, "wb");
+    if (out == NULL){
+        fclose(in);
+        return false;
+    }
+
+    ok = true;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+        if (fwrite(buf, 1, n, out) != n){
+            ok = false;
+            break;
+        }
+
+    if (ferror(in))
+        ok = false;
+    fclose(in);
+    if (fclose(out) != 0)
+        ok = false;
+    return ok;
+}
+
+bool get_cache_key(char *fname, char *options, char *key){
+    Sha256 sha;
+    FILE *fp;
+    char buf[COPY_CHUNK_SIZE];
+    size_t n;
+
+    fp = ctx_fopen(fname, "rb");
+    if (fp == NULL)
+        return false;
+
+    /* Version and options first, each followed by a null character */
+    sha256_init(&sha);
+    sha256_update(&sha, ASSEMBLER_VERSION, strlen(ASSEMBLER_VERSION) + 1);
+    sha256_update(&sha, options, strlen(options) + 1);
+
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        sha256_update(&sha, buf, n);
+
+    if (ferror(fp)){
+        fclose(fp);
+        return false;
+    }
+    fclose(fp);
+
+    sha256_final_hex(&sha, key);
+    return true;
+}
+
+bool restore_from_cache(char *cache_dir, char *key, char *basename, bool with_binary){
+    char *entry;
+    int i;
+
+    /* An entry only exists once it is complete */
+    entry = join_path(cache_dir, key, "");
+    if (access(entry, F_OK) != 0)
+        return false;
+
+    for (i = 0; i < OUTPUTS_CNT(with_binary); i++)
+        if (!copy_file(join_path(entry, CACHE_OUTPUT_NAME, outputs_suffixes[i]), join_path(NULL, basename, outputs_suffixes[i])))
+            return false;
+
+    return true;
+}
+
+void store_in_cache(char *cache_dir, char *key, char *basename, bool with_binary){
+    char *entry, *tmp_entry;
+    int i;
+
+    entry = join_path(cache_dir, key, "");
+    if (access(entry, F_OK) == 0)
+        return;
+
+    /* Fill a private temporary directory */
+    if (mkdir(cache_dir, 0777) != 0 && errno != EEXIST)
+        return;
+    tmp_entry = join_path(cache_dir, CACHE_TMP_PREFIX, "XXXXXX");
+    if (mkdtemp(tmp_entry) == NULL)
+        return;
+    chmod(tmp_entry, 0755); /* mkdtemp makes it private, the cache may be shared */
+
+    for (i = 0; i < OUTPUTS_CNT(with_binary); i++)
+        if (!copy_file(join_path(NULL, basename, outputs_suffixes[i]), join_path(tmp_entry, CACHE_OUTPUT_NAME, outputs_suffixes[i])))
+            break;
+
+    /* Publish the entry in one rename, it fails if another build published it first */
+    if (i < OUTPUTS_CNT(with_binary) || rename(tmp_entry, entry) != 0){
+        for (i = 0; i < OUTPUTS_CNT(with_binary); i++)
+            remove(join_path(tmp_entry, CACHE_OUTPUT_NAME, outputs_suffixes[i]));
+        rmdir(tmp_entry);
+    }
+}
@@ -0,0 +1,58 @@
+/*
+ * Content-addressed build cache (--cache DIR)
+ * The outputs of a source file are stored under the hash of its content, the version of the
+ * assembler and the options that change the outputs. When a source file is assembled again
+ * with the same hash, its outputs are copied back from the cache without assembling it.
+ *
+ * Every entry is a directory named after the hash, holding one file per output suffix.
+ * Entries are filled in a temporary directory that is renamed once complete, so a build
+ * never sees a partial entry and several builds can share the same cache directory.
+ */
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+#include "sha256.h"
+
+#define CACHE_KEY_SIZE SHA256_HEX_SIZE
+
+/*
+ * Compute the cache key of a source file
+ *
+ * Args:
+ * fname - Name of the source file
+ * options - Options that change the outputs (part of the key)
+ * key - Where the key is written (CACHE_KEY_SIZE characters)
+ *
+ * Return:
+ * False if the file cannot be read
+ */
+bool get_cache_key(char *fname, char *options, char *key);
+
+/*
+ * Copy the outputs of a source file from the cache
+ *
+ * Args:
+ * cache_dir - The cache directory
+ * key - Cache key of the source file
+ * basename - Basename of the source file (outputs are <basename><suffix>)
+ * with_binary - True if the binary object file is an output too
+ *
+ * Return:
+ * True if the entry was in the cache and every output was restored
+ */
+bool restore_from_cache(char *cache_dir, char *key, char *basename, bool with_binary);
+
+/*
+ * Store the outputs of an assembled source file in the cache
+ * Nothing is done if the entry already exists or the cache cannot be written
+ *
+ * Args:
+ * cache_dir - The cache directory
+ * key - Cache key of the source file
+ * basename - Basename of the source file (outputs are <basename><suffix>)
+ * with_binary - True if the binary object file is an output too
+ */
+void store_in_cache(char *cache_dir, char *key, char *basename, bool with_binary);
+
+#endif
@@ -0,0 +1,94 @@
+/*
+ * Chunks of lines of a source file, processed at the same time on worker threads
+ */
+#include <stdlib.h>
+#include "errors.h"
+#include "jobs.h"
+#include "chunks.h"
+
+Chunk *create_chunks(SourceFile *src, int workers_cnt, int *cnt){
+    Context *ctx;
+    Chunk *chunks;
+    int i, chunks_cnt;
+
+    /* As many chunks as the workers can share, as long as they are big enough */
+    chunks_cnt = workers_cnt * CHUNKS_PER_WORKER;
+    if (chunks_cnt > src->lines_cnt / CHUNK_MIN_LINES)
+        chunks_cnt = src->lines_cnt / CHUNK_MIN_LINES;
+    if (workers_cnt <= 1 || chunks_cnt < 2)
+        return NULL;
+
+    chunks = (Chunk *) calloc(chunks_cnt, sizeof(Chunk));
+    if (chunks == NULL)
+        raise_error("Internal error: out of memory.");
+
+    for (i = 0; i < chunks_cnt; i++){
+        chunks[i].src = src;
+        chunks[i].first_line = (int) ((long) src->lines_cnt * i / chunks_cnt);
+        chunks[i].end_line = (int) ((long) src->lines_cnt * (i + 1) / chunks_cnt);
+        chunks[i].ctx = create_context(src->fname);
+        if (chunks[i].ctx == NULL){
+            free_chunks(chunks, i);
+            raise_error("Internal error: out of memory.");
+        }
+        chunks[i].ctx->chunk = &chunks[i];
+    }
+
+    ctx = get_current_context();
+    if (ctx != NULL){
+        ctx->chunks = chunks;
+        ctx->chunks_cnt = chunks_cnt;
+    }
+
+    *cnt = chunks_cnt;
+    return chunks;
+}
+
+/*
+ * Run the function of the chunk of a context
+ */
+static void run_chunk(Context *ctx){
+    ctx->chunk->func(ctx->chunk);
+}
+
+/*
+ * Job of a worker: run a chunk in its context
+ */
+static void chunk_job(void *chunk){
+    run_in_context(((Chunk *) chunk)->ctx, run_chunk);
+}
+
+int run_chunks(Chunk *chunks, int cnt, int workers_cnt, void (*func)(Chunk *)){
+    void **jobs;
+    int i;
+
+    jobs = (void **) ctx_calloc(cnt, sizeof(void *));
+    for (i = 0; i < cnt; i++){
+        chunks[i].func = func;
+        jobs[i] = &chunks[i];
+    }
+
+    run_jobs(chunk_job, jobs, cnt, workers_cnt);
+
+    for (i = 0; i < cnt && !chunks[i].ctx->failed; i++) {}
+    return i;
+}
+
+void free_chunks(Chunk *chunks, int cnt){
+    Context *ctx;
+    int i;
+
+    if (chunks == NULL)
+        return;
+
+    ctx = get_current_context();
+    if (ctx != NULL && ctx->chunks == chunks)
+        ctx->chunks = NULL;
+
+    for (i = 0; i < cnt; i++){
+        if (chunks[i].free_data != NULL)
+            chunks[i].free_data(&chunks[i]);
+        free_context(chunks[i].ctx);
+    }
+    free(chunks);
+}
@@ -0,0 +1,82 @@
+/*
+ * Chunks of lines of a source file, processed at the same time on worker threads
+ * Each chunk runs in its own context: its messages are kept in the log of the chunk (the pass merges
+ * them in line order), and an error raised by a chunk only stops that chunk. The pass then stops
+ * where a serial run would have stopped: at the first chunk that failed.
+ * Only big files are split, smaller files are processed on the calling thread as a whole.
+ */
+#ifndef CHUNKS_H
+#define CHUNKS_H
+
+#include <stdbool.h>
+#include "source.h"
+#include "context.h"
+
+/* A file is split only if every chunk gets at least this number of lines */
+#define CHUNK_MIN_LINES 16384
+
+/* Number of chunks per worker, so that a slow chunk doesn't keep the other workers waiting */
+#define CHUNKS_PER_WORKER 4
+
+/*
+ * Represent a chunk of lines
+ *
+ * Attributes:
+ * ctx - Context of the chunk (its log holds the messages of the chunk)
+ * src - The source file
+ * first_line - Index of the first line of the chunk
+ * end_line - Index of the line after the last line of the chunk
+ * data - Data of the pass for this chunk
+ * func - Function run on the chunk
+ * free_data - Function freeing the data of the chunk, NULL if there is nothing to free
+ */
+typedef struct Chunk{
+	Context *ctx;
+	SourceFile *src;
+	int first_line;
+	int end_line;
+	void *data;
+	void (*func)(struct Chunk *);
+	void (*free_data)(struct Chunk *);
+} Chunk;
+
+/*
+ * Split the lines of a source file into chunks, if it is big enough
+ * The chunks are kept in the current context until they are freed, so that an error stopping the pass frees them
+ * An error is raised if there is no memory
+ *
+ * Args:
+ * src - The source file
+ * workers_cnt - Number of workers the chunks will run on
+ * cnt - Where the number of chunks is written
+ *
+ * Return:
+ * The chunks (free them with free_chunks), NULL if the file is not worth splitting
+ */
+Chunk *create_chunks(SourceFile *src, int workers_cnt, int *cnt);
+
+/*
+ * Run a function on every chunk, on worker threads
+ * The messages of each chunk stay in its log, the caller merges them in line order
+ *
+ * Args:
+ * chunks - The chunks
+ * cnt - Number of chunks
+ * workers_cnt - Number of worker threads
+ * func - The function to run, it receives the chunk (the context of the chunk is the current context)
+ *
+ * Return:
+ * Index of the first chunk stopped by an error, <cnt> if every chunk succeeded
+ */
+int run_chunks(Chunk *chunks, int cnt, int workers_cnt, void (*func)(Chunk *));
+
+/*
+ * Free chunks, their contexts and their data (see <free_data>)
+ *
+ * Args:
+ * chunks - The chunks
+ * cnt - Number of chunks
+ */
+void free_chunks(Chunk *chunks, int cnt);
+
+#endif
@@ -0,0 +1,216 @@
+/*
+ * Per-file assembling context
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "errors.h"
+#include "context.h"
+#include "chunks.h"
+#include "stream.h"
+
+#define LOG_INIT_SIZE 256
+
+/*
+ * Key of the thread specific pointer to the current context
+ */
+static pthread_key_t current_ctx_key;
+static pthread_once_t current_ctx_once = PTHREAD_ONCE_INIT;
+
+static void create_current_ctx_key(){
+    pthread_key_create(&current_ctx_key, NULL);
+}
+
+/*
+ * Free what the passes of a file did not free (an error stopped them, or the second pass never ran)
+ */
+static void free_pass_resources(Context *ctx){
+    discard_writer(ctx->obj_writer);
+    discard_writer(ctx->ext_writer);
+    discard_writer(ctx->data_spill);
+    close_source_stream(ctx->stream);
+    free_external_refs(ctx->ext_refs);
+    free_chunks(ctx->chunks, ctx->chunks_cnt);
+    free_data_image(ctx->data_img);
+    free_labels_table(ctx->labels);
+
+    ctx->obj_writer = NULL;
+    ctx->ext_writer = NULL;
+    ctx->data_spill = NULL;
+    ctx->stream = NULL;
+    ctx->ext_refs = NULL;
+    ctx->chunks = NULL;
+    ctx->data_img = NULL;
+    ctx->labels = NULL;
+}
+
+Context *create_context(char *fname){
+    Context *ctx;
+
+    ctx = (Context *) calloc(1, sizeof(Context));
+    if (ctx == NULL)
+        return NULL;
+
+    ctx->fname = fname;
+    ctx->is_valid = true;
+    ctx->line_workers = 1;
+    ctx->arena = create_arena();
+    if (ctx->arena == NULL){
+        free(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+void free_context(Context *ctx){
+    if (ctx == NULL)
+        return;
+
+    free_source_file(ctx->src);
+    free(ctx->content);
+    free_pass_resources(ctx);
+    free_arena(ctx->arena);
+    free(ctx->log);
+    free(ctx);
+}
+
+void reset_context(Context *ctx, char *fname){
+    free_source_file(ctx->src);
+    free(ctx->content);
+    free_pass_resources(ctx);
+
+    ctx->fname = fname;
+    ctx->content = NULL;
+    ctx->content_size = 0;
+    ctx->out_basename = NULL;
+    ctx->src = NULL;
+    ctx->size = 0;
+    ctx->log_len = 0;
+    ctx->is_valid = true;
+    ctx->failed = false;
+    memset(&ctx->stats, 0, sizeof(Stats));
+    ctx->binary_output = false;
+    ctx->group_externals = false;
+    ctx->streaming = false;
+    ctx->cache_dir = NULL;
+    ctx->cache_key[0] = '\0';
+    ctx->cached = false;
+    ctx->result = NULL;
+    ctx->object_text = false;
+    ctx->ic_size = ctx->dc_size = 0;
+    ctx->line_workers = 1;
+}
+
+Context *get_current_context(){
+    pthread_once(&current_ctx_once, create_current_ctx_key);
+    return (Context *) pthread_getspecific(current_ctx_key);
+}
+
+void *ctx_calloc(size_t cnt, size_t size){
+    Context *ctx;
+    void *ptr;
+
+    ctx = get_current_context();
+    if (ctx != NULL)
+        return arena_alloc(ctx->arena, cnt * size);
+
+    ptr = calloc(cnt, size);
+    if (ptr == NULL)
+        raise_error("Internal error: out of memory.");
+    return ptr;
+}
+
+ArenaMark ctx_mark(){
+    Context *ctx;
+    ArenaMark mark;
+
+    ctx = get_current_context();
+    if (ctx != NULL)
+        return arena_mark(ctx->arena);
+
+    mark.block = NULL;
+    mark.used = 0;
+    return mark;
+}
+
+void ctx_release(ArenaMark mark){
+    Context *ctx;
+
+    ctx = get_current_context();
+    if (ctx != NULL)
+        arena_release(ctx->arena, mark);
+}
+
+Stats *ctx_stats(){
+    Context *ctx;
+
+    ctx = get_current_context();
+    return ctx != NULL ? &ctx->stats : NULL;
+}
+
+FILE *ctx_fopen(char *fname, char *mode){
+    Context *ctx;
+
+    ctx = get_current_context();
+    if (ctx != NULL)
+        ctx->stats.file_opens++;
+
+    return fopen(fname, mode);
+}
+
+void add_to_log(Context *ctx, char *msg, size_t len){
+    char *new_log;
+    size_t new_size;
+
+    if (len == 0)
+        return;
+
+    if (ctx->log_len + len + 1 > ctx->log_size){
+        new_size = ctx->log_size ? ctx->log_size : LOG_INIT_SIZE;
+        while (ctx->log_len + len + 1 > new_size)
+            new_size *= 2;
+
+        new_log = (char *) realloc(ctx->log, new_size);
+        if (new_log == NULL)
+            return; /* Drop the message rather than losing the whole log */
+
+        ctx->log = new_log;
+        ctx->log_size = new_size;
+    }
+
+    memcpy(ctx->log + ctx->log_len, msg, len);
+    ctx->log_len += len;
+    ctx->log[ctx->log_len] = '\0';
+}
+
+void flush_log(Context *ctx){
+    if (ctx->log_len == 0)
+        return;
+
+    fwrite(ctx->log, 1, ctx->log_len, stdout);
+    ctx->log_len = 0;
+}
+
+bool run_in_context(Context *ctx, void (*func)(Context *)){
+    Context *prev_ctx;
+
+    prev_ctx = get_current_context();
+    pthread_setspecific(current_ctx_key, ctx);
+
+    /* raise_error jumps back here */
+    if (setjmp(ctx->on_error) == 0)
+        func(ctx);
+    else
+        ctx->failed = true;
+
+    pthread_setspecific(current_ctx_key, prev_ctx);
+    if (ctx->failed)
+        free_pass_resources(ctx);
+
+    /* Everything allocated by the function is released in one shot */
+    reset_arena(ctx->arena);
+    return !ctx->failed;
+}
@@ -0,0 +1,211 @@
+/*
+ * Per-file assembling context
+ * Everything that belongs to the assembling of one source file, so that several
+ * files can be assembled at the same time (each one on its own thread)
+ */
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <setjmp.h>
+#include "source.h"
+#include "encoder.h"
+#include "labels.h"
+#include "writer.h"
+#include "arena.h"
+#include "stats.h"
+#include "cache.h"
+#include "libassembler.h"
+
+/*
+ * Represent the assembling of a source file
+ *
+ * Attributes:
+ * fname - Name of the source file
+ * content - Content of the source file when it is not read from <fname> (see read_source_buffer), NULL otherwise
+ * content_size - Size of <content>
+ * out_basename - Base name of the outputs (without suffix), NULL to write them next to the source file
+ * src - The parsed source file, NULL until it has been read
+ * size - Size of the source file in bytes (the biggest files are scheduled first)
+ * arena - Arena of the temporary allocations made while checking and assembling the file
+ * log - Console messages of the file, printed once the file is done
+ * log_len - Number of characters in <log>
+ * log_size - Number of allocated characters in <log>
+ * is_valid - False if the errors checker found errors in the file
+ * failed - True if an error stopped the assembling of the file
+ * stats - Statistics of the assembling of the file (see --stats)
+ * binary_output - True if a binary object file is written too (see --binary)
+ * group_externals - True if the external references are grouped by label (see --group-externals)
+ * cache_dir - The build cache directory, NULL if there is none (see --cache)
+ * cache_key - Cache key of the source file, empty if it has none
+ * cached - True if the outputs were restored from the cache (the file is not assembled)
+ * result - Where the outputs are kept in memory (see libassembler.h), NULL to write the output files
+ * object_text - True if the object file is rendered in <result> too
+ * labels - Labels table of the file, from the first pass until the end of the second pass
+ * ic_size - Size of the code computed by the first pass (in bytes)
+ * dc_size - Size of the data computed by the first pass (in bytes)
+ * data_img - Data image of the file while it is assembled
+ * obj_writer - Writer of the object file while it is open
+ * ext_refs - External references of the file while it is encoded
+ * streaming - True if the file is streamed through a window instead of being read at once (see --stream)
+ * stream - The stream of the file while a pass reads it (see stream.h)
+ * ext_writer - Writer of the externals file while a streamed file is encoded
+ * data_spill - Writer of the temporary file the data image of a streamed file is spilled to
+ * line_workers - Number of threads the lines of a big file can be split on (see chunks.h)
+ * chunk - The chunk of lines the context works on, NULL if it works on a whole file
+ * chunks - Chunks of lines of the file while a pass runs on them
+ * chunks_cnt - Number of chunks
+ * on_error - Where raise_error jumps to when the file fails
+ */
+typedef struct Context{
+	char *fname;
+	char *content;
+	size_t content_size;
+	char *out_basename;
+	SourceFile *src;
+	long size;
+	Arena *arena;
+	char *log;
+	size_t log_len;
+	size_t log_size;
+	bool is_valid;
+	bool failed;
+	Stats stats;
+	bool binary_output;
+	bool group_externals;
+	char *cache_dir;
+	char cache_key[CACHE_KEY_SIZE];
+	bool cached;
+	AsmResult *result;
+	bool object_text;
+	LabelsTable *labels;
+	int ic_size;
+	int dc_size;
+	DataImage *data_img;
+	Writer *obj_writer;
+	ExternalRefs *ext_refs;
+	bool streaming;
+	struct SourceStream *stream;
+	Writer *ext_writer;
+	Writer *data_spill;
+	int line_workers;
+	struct Chunk *chunk;
+	struct Chunk *chunks;
+	int chunks_cnt;
+	jmp_buf on_error;
+} Context;
+
+/*
+ * Create the context of a source file
+ *
+ * Args:
+ * fname - Name of the source file
+ *
+ * Return:
+ * The new context, NULL if there is no memory
+ */
+Context *create_context(char *fname);
+
+/*
+ * Free a context, its source file and its log
+ *
+ * Args:
+ * ctx - The context to free
+ */
+void free_context(Context *ctx);
+
+/*
+ * Prepare a context for another source file, keeping its arena and log buffer warm
+ * The source file, the messages, the statistics and the flags of the previous file are dropped
+ *
+ * Args:
+ * ctx - The context
+ * fname - Name of the new source file
+ */
+void reset_context(Context *ctx, char *fname);
+
+/*
+ * Return the context the calling thread is working on, NULL if there is none
+ */
+Context *get_current_context();
+
+/*
+ * Allocate zeroed memory from the arena of the current context
+ * (or from the heap when there is no current context)
+ * The memory is released when the context is done with the file, never free it
+ *
+ * Args:
+ * cnt - Number of elements
+ * size - Size of an element
+ *
+ * Return:
+ * Pointer to the allocated memory
+ */
+void *ctx_calloc(size_t cnt, size_t size);
+
+/*
+ * Return the position of the arena of the current context
+ */
+ArenaMark ctx_mark();
+
+/*
+ * Release everything allocated from the arena of the current context after a mark
+ *
+ * Args:
+ * mark - Mark returned by ctx_mark
+ */
+void ctx_release(ArenaMark mark);
+
+/*
+ * Return the statistics of the current context, NULL if there is no current context
+ */
+Stats *ctx_stats();
+
+/*
+ * Open a file (like fopen), counted in the statistics of the current context
+ *
+ * Args:
+ * fname - Name of the file
+ * mode - Mode of fopen
+ *
+ * Return:
+ * The opened stream, NULL if the file cannot be opened
+ */
+FILE *ctx_fopen(char *fname, char *mode);
+
+/*
+ * Append a message to the log of a context
+ *
+ * Args:
+ * ctx - The context
+ * msg - The message
+ * len - Length of the message
+ */
+void add_to_log(Context *ctx, char *msg, size_t len);
+
+/*
+ * Print the log of a context to the standard output and empty it
+ *
+ * Args:
+ * ctx - The context
+ */
+void flush_log(Context *ctx);
+
+/*
+ * Run a function in a context: the messages of the function are written to the log of the
+ * context, and an error raised by the function only stops the function (not the program)
+ * Everything allocated from the arena of the context is released when the function returns,
+ * and if the function failed, the labels table, data image and object writer the passes left behind are freed
+ *
+ * Args:
+ * ctx - The context
+ * func - The function to run, it receives the context
+ *
+ * Return:
+ * False if an error was raised while running the function
+ */
+bool run_in_context(Context *ctx, void (*func)(Context *));
+
+#endif
@@ -5,288 +5,402 @@
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <math.h>
+#include <string.h>
 #include "errors.h"
 #include "utils.h"
 #include "encoder.h"
 #include "labels.h"
 #include "globals.h"
 #include "instructions.h"
+#include "writer.h"
+#include "context.h"
 
-#define TMP_DATA_MMAP_FILE "tmp_data_mmap.ob"
-#define TMP_EXTERNALS_MMAP_FILE "tmp_externals_mmap.ob"
+#define OBJ_LINE_MAX_SIZE 24 /* Address (up to 10 digits), 4 bytes, the spaces and the line break */
+#define OBJ_LINES_PER_BATCH (WRITER_BUFFER_SIZE / OBJ_LINE_MAX_SIZE)
+#define EXTERNAL_REFS_INIT_CAPACITY 64
 
-void dump_bitmap(BITMAP_32 *bitmap, char *fname, int line_no, int bytes_to_dump) {
-	int i, j;
-    int bit, bytes_dumped;
-    unsigned int as_int;
-    FILE *fp;
+/*
+ * Hexadecimal representation of every byte
+ */
+static const char hex_table[256][3] = {
+    "00", "01", "02", "03", "04", "05", "06", "07", "08", "09", "0A", "0B", "0C", "0D", "0E", "0F",
+    "10", "11", "12", "13", "14", "15", "16", "17", "18", "19", "1A", "1B", "1C", "1D", "1E", "1F",
+    "20", "21", "22", "23", "24", "25", "26", "27", "28", "29", "2A", "2B", "2C", "2D", "2E", "2F",
+    "30", "31", "32", "33", "34", "35", "36", "37", "38", "39", "3A", "3B", "3C", "3D", "3E", "3F",
+    "40", "41", "42", "43", "44", "45", "46", "47", "48", "49", "4A", "4B", "4C", "4D", "4E", "4F",
+    "50", "51", "52", "53", "54", "55", "56", "57", "58", "59", "5A", "5B", "5C", "5D", "5E", "5F",
+    "60", "61", "62", "63", "64", "65", "66", "67", "68", "69", "6A", "6B", "6C", "6D", "6E", "6F",
+    "70", "71", "72", "73", "74", "75", "76", "77", "78", "79", "7A", "7B", "7C", "7D", "7E", "7F",
+    "80", "81", "82", "83", "84", "85", "86", "87", "88", "89", "8A", "8B", "8C", "8D", "8E", "8F",
+    "90", "91", "92", "93", "94", "95", "96", "97", "98", "99", "9A", "9B", "9C", "9D", "9E", "9F",
+    "A0", "A1", "A2", "A3", "A4", "A5", "A6", "A7", "A8", "A9", "AA", "AB", "AC", "AD", "AE", "AF",
+    "B0", "B1", "B2", "B3", "B4", "B5", "B6", "B7", "B8", "B9", "BA", "BB", "BC", "BD", "BE", "BF",
+    "C0", "C1", "C2", "C3", "C4", "C5", "C6", "C7", "C8", "C9", "CA", "CB", "CC", "CD", "CE", "CF",
+    "D0", "D1", "D2", "D3", "D4", "D5", "D6", "D7", "D8", "D9", "DA", "DB", "DC", "DD", "DE", "DF",
+    "E0", "E1", "E2", "E3", "E4", "E5", "E6", "E7", "E8", "E9", "EA", "EB", "EC", "ED", "EE", "EF",
+    "F0", "F1", "F2", "F3", "F4", "F5", "F6", "F7", "F8", "F9", "FA", "FB", "FC", "FD", "FE", "FF"
+};
+
+/*
+ * Write an address in decimal, on at least 4 digits, followed by a space
+ *
+ * Args:
+ * out - Where the address is written (at least OBJ_LINE_MAX_SIZE characters)
+ * addr - The address
+ *
+ * Return:
+ * Number of characters written
+ */
+static int format_address(char *out, unsigned int addr){
+    char digits[10]; /* Digits of the address, lowest first */
+    int cnt, len;
+
+    cnt = len = 0;
+    do {
+        digits[cnt++] = '0' + addr % 10;
+        addr /= 10;
+    } while (addr > 0);
+
+    /* Pad with zeros up to 4 digits */
+    while (len + cnt < 4)
+        out[len++] = '0';
+    while (cnt > 0)
+        out[len++] = digits[--cnt];
+
+    out[len++] = ' ';
+    return len;
+}
+
+/*
+ * Write a line of the object file: the address, then up to 4 bytes in hexadecimal
+ *
+ * Args:
+ * out - Where the line is written (at least OBJ_LINE_MAX_SIZE characters)
+ * addr - Address of the first byte
+ * bytes - The bytes to write
+ * n - Number of bytes (from 1 to 4)
+ *
+ * Return:
+ * Number of characters written
+ */
+static int format_obj_line(char *out, int addr, const unsigned char *bytes, int n){
+    int i, len;
 
-    j = as_int = bytes_dumped = 0;
-    fp = fopen(fname, "a");
+    len = format_address(out, addr);
+    for (i = 0; i < n; i++){
+        out[len++] = hex_table[bytes[i]][0];
+        out[len++] = hex_table[bytes[i]][1];
 
-    /* Dump the line number */
-    fprintf(fp, "%04d ", line_no);
+        /* Add a space if it's not the last byte */
+        if (i < n - 1)
+            out[len++] = ' ';
+    }
 
-    /* Dump the bits */
-    for (i = 31; i >= 0; i--){
-        bit = TestBit(*bitmap, i);
+    out[len++] = '\n';
+    return len;
+}
 
-        /* Add this bit to the integer */
-        if (bit)
-            as_int += (int) pow(2, j);
+/*
+ * Split a word into its bytes, lowest first
+ */
+static void word_to_bytes(WORD_32 word, unsigned char *bytes){
+    bytes[0] = word & 0xFF;
+    bytes[1] = (word >> 8) & 0xFF;
+    bytes[2] = (word >> 16) & 0xFF;
+    bytes[3] = (word >> 24) & 0xFF;
+}
 
-        j++;
+void dump_word(WORD_32 word, Writer *w, int line_no) {
+    unsigned char bytes[4];
+    char *out;
 
-        /* Every 8 bits: convert the decimal value to hexadecimal and print it in the file */
-        if (j == 8){
-            /* Dump the hex value */
-            fprintf(fp, "%02X", as_int);
+    word_to_bytes(word, bytes);
+    out = reserve_in_writer(w, OBJ_LINE_MAX_SIZE);
+    advance_writer(w, format_obj_line(out, line_no, bytes, 4));
+}
 
-            /* Add a space if it's not the last byte */
-            if (i>0)
-                fprintf(fp, " ");
+void dump_words(WORD_32 *words, int cnt, Writer *w, int first_addr){
+    unsigned char bytes[4];
+    char *out;
+    int i, len, batch_end;
 
-            /* Reset j and as_int */
-            j = as_int = 0;
+    /* Format as many lines at once as the buffer of the writer can hold */
+    for (i = 0; i < cnt; ){
+        batch_end = cnt - i < OBJ_LINES_PER_BATCH ? cnt : i + OBJ_LINES_PER_BATCH;
+        out = reserve_in_writer(w, (batch_end - i) * OBJ_LINE_MAX_SIZE);
 
-            if (bytes_dumped == bytes_to_dump)
-                break;
+        for (len = 0; i < batch_end; i++){
+            word_to_bytes(words[i], bytes);
+            len += format_obj_line(out + len, first_addr + 4 * i, bytes, 4);
         }
+        advance_writer(w, len);
     }
-
-    fprintf(fp, "\n");
-    fclose(fp);
 }
 
-void reverse_dump_bitmap(BITMAP_32 *bitmap, char *fname, int line_no, int bytes_to_dump) {
-    FILE *fp;
-	int i, j, k;
-    int bit;
-    unsigned int as_int; /* Temporary value used for converting a byte to integer */
-    int sentence[4]; /* Hold 4 bytes */
+DataImage *create_data_image(int size){
+    DataImage *img;
 
-    k = j = as_int = 0;
-    fp = fopen(fname, "a");
+    img = (DataImage *) calloc(1, sizeof(DataImage));
+    if (img == NULL)
+        raise_error("Internal error: cannot allocate the data image.");
 
-    /* Dump the line number */
-    fprintf(fp, "%04d ", line_no);
+    img->size = size > 0 ? size : 1;
+    img->bytes = (unsigned char *) malloc(img->size);
 
-    /* Dump the bits as hexadecimal values in reverse order */
-    for (i = (bytes_to_dump*8)-1; i >= 0; i--){
-        bit = TestBit(*bitmap, i);
+    if (img->bytes == NULL)
+        raise_error("Internal error: cannot allocate the data image.");
 
-        /* Add this bit to the integer */
-        if (bit)
-            as_int += (int) pow(2, j);
+    return img;
+}
 
-        j++;
+void free_data_image(DataImage *img){
+    if (img == NULL)
+        return;
 
-        /* Every 8 bits: convert the decimal value to hexadecimal and add it to the sentence */
-        if (j == 8){
-            sentence[k++] = as_int;
+    free(img->bytes);
+    free(img);
+}
 
-            /* Reset j and as_int */
-            j = as_int = 0;
-        }
+/*
+ * Append a byte to a data image, growing it if needed
+ */
+static void add_byte_to_image(DataImage *img, unsigned char byte){
+    if (img->len == img->size){
+        img->size *= 2;
+        img->bytes = (unsigned char *) realloc(img->bytes, img->size);
+        if (img->bytes == NULL)
+            raise_error("Internal error: cannot grow the data image.");
     }
 
-    /* Dump the whole sentence */
-    for (i=bytes_to_dump-1; i >= 0 ; i--){
-        /* Dump the hex value */
-        fprintf(fp, "%02X", sentence[i]);
+    img->bytes[img->len++] = byte;
+}
 
-        /* Add a space if it's not the last byte */
-        if (i>0)
-            fprintf(fp, " ");
+void append_to_data_image(DataImage *img, unsigned char *bytes, int len){
+    unsigned char *new_bytes;
+    int new_size;
+
+    if (img->len + len > img->size){
+        for (new_size = img->size; img->len + len > new_size; new_size *= 2) {}
+        new_bytes = (unsigned char *) realloc(img->bytes, new_size);
+        if (new_bytes == NULL)
+            raise_error("Internal error: cannot grow the data image.");
+        img->bytes = new_bytes;
+        img->size = new_size;
     }
 
-    fprintf(fp, "\n");
-    fclose(fp);
+    memcpy(img->bytes + img->len, bytes, len);
+    img->len += len;
 }
 
+/*
+ * Return the value of an operand used as a number (0 if the operand is not an immediate, as atoi reads it)
+ */
+static int immediate_value(Token *tok){
+    return tok->kind == IMMEDIATE_TOKEN ? tok->value : 0;
+}
 
-void tmp_dump_data_instruction(char *line_ptr){
-    char *token; /* Used for strtok */
-    char *instruction_name; /* Name of the data instruction */
-    char *params; /* Parameters of the lines */
-    int byte[8];
-    int byte_ix;
-    int size; /* Size of the encoded word in bits */
-    int i, j, val; /* Temporary variables */
-    FILE *fp;
-
-	instruction_name = get_instruction(line_ptr);
+int get_data_size(SourceLine *line){
+    /* A string takes its characters and the \0 character */
+    if (line->directive->value_size == 0)
+        return line->operands_cnt > 0 ? line->operands[0].len + 1 : 0;
 
-	params = (char *) calloc(LINE_MAX_SIZE, sizeof(char));
-	strcpy(params, line_ptr + strlen(instruction_name));
-	params = trim_whitespaces(params);
+    return line->operands_cnt * line->directive->value_size;
+}
 
-    /* Skip the operation name */
-    while ( !isspace(*line_ptr++) ) {}
+void encode_data_instruction(SourceLine *line, DataImage *img){
+    Token *tok;
+    int i, j, val;
 
-    /* Skip every trailing whitespace (even if there shouldn't be) */
-    while ( isspace(*line_ptr) )
-        line_ptr++;
+    if (line->directive->value_size == 0){
+        /* Encode every character of the string, then the \0 character */
+        tok = &line->operands[0];
+        for (i = 0; i < tok->len; i++)
+            add_byte_to_image(img, (unsigned char) tok->text[i]);
+        add_byte_to_image(img, 0);
+        return;
+    }
 
-    fp = fopen(TMP_DATA_MMAP_FILE, "a");
+    /* Encode every number */
+    for (i = 0; i < line->operands_cnt; i++){
+        val = immediate_value(&line->operands[i]);
 
-    if (STREQ(instruction_name, ".asciz")){
-        /* Encode every character between the quotes and dump them */
+        /* Little endian: the lowest byte comes first */
+        for (j = 0; j < line->directive->value_size; j++)
+            add_byte_to_image(img, (unsigned char) ((val >> (8*j)) & 0xFF));
+    }
+}
 
-        /* Go to the quote */
-        while (*line_ptr++ != '"') {}
+void dump_data_image(DataImage *img, Writer *w, int dc_offset){
+    char *out;
+    int i, n, len, batch_end;
 
-        /* Parse until the closing quote */
-        while (*line_ptr != '"'){
-            for(i = 7; i >= 0; i-- ){
-                fprintf(fp, "%d", ( *line_ptr >> i ) & 1 ? 1 : 0 );
-            }
+    /* Dump the bytes 4 by 4 (the last line may be shorter), as many lines at once as the writer can hold */
+    for (i = 0; i < img->len; ){
+        batch_end = img->len - i < 4 * OBJ_LINES_PER_BATCH ? img->len : i + 4 * OBJ_LINES_PER_BATCH;
+        out = reserve_in_writer(w, (batch_end - i + 3) / 4 * OBJ_LINE_MAX_SIZE);
 
-            line_ptr++;
+        for (len = 0; i < batch_end; i += n){
+            n = batch_end - i < 4 ? batch_end - i : 4;
+            len += format_obj_line(out + len, dc_offset + i, img->bytes + i, n);
         }
-        /* Add the \0 character */
-        fprintf(fp, "00000000");
-    }
-    else{
-        /* Encode every number  */
-        if (STREQ(instruction_name, ".db"))
-            size = 8;
-        else if (STREQ(instruction_name, ".dh"))
-            size = 16;
-        else /* instruction is .dw*/
-            size = 32;
-
-		token = strtok(params, ",");
-		while (token)
-		{
-            val = atoi(token);
-
-            /* We need to reverse the bytes so that the last byte appear first */
-            byte_ix = 0;
-
-            for(i = 0; i <= size-1; i++ ){
-                byte[byte_ix++] = ((val >> i) & 1);
-
-                if (byte_ix == 8){
-                    byte_ix = 0;
-                    for (j=7; j >= 0; j--) {/* Put them in Little endian format in the file */
-                        fprintf(fp, "%d", byte[j]);
-                    }
-	        	}
-	        }
-
-			token = strtok(NULL, ",");
-		}
+        advance_writer(w, len);
     }
+}
 
-    fclose(fp);
+ExternalRefs *create_external_refs(){
+    ExternalRefs *refs;
 
+    refs = (ExternalRefs *) calloc(1, sizeof(ExternalRefs));
+    if (refs == NULL)
+        raise_error("Internal error: out of memory.");
+
+    return refs;
 }
 
-void tmp_dump_external_label(char *lbl_name, LabelsTable *labels_table_ptr, int frame_no){
-    FILE *fp;
-    Label *lbl;
+void free_external_refs(ExternalRefs *refs){
+    if (refs == NULL)
+        return;
 
-    lbl = get_label_by_name(labels_table_ptr, lbl_name);
+    free(refs->refs);
+    free(refs);
+}
 
-    if (lbl == NULL){
-        printf("[x] Error on line %d, label %s doesn't exist", frame_no, lbl_name);
-        raise_error(NULL);
-        return;
-    }
+/*
+ * Make room for <n> more references, growing the vector if needed
+ */
+static void reserve_external_refs(ExternalRefs *refs, int n){
+    ExternalRef *new_refs;
+    int new_cap;
 
-    fp = fopen(TMP_EXTERNALS_MMAP_FILE, "a");
+    if (refs->cnt + n <= refs->cap)
+        return;
 
-    fprintf(fp, "%s %04d\n", lbl->label, frame_no);
+    for (new_cap = refs->cap ? refs->cap : EXTERNAL_REFS_INIT_CAPACITY; refs->cnt + n > new_cap; new_cap *= 2) {}
+    new_refs = (ExternalRef *) realloc(refs->refs, new_cap * sizeof(ExternalRef));
+    if (new_refs == NULL)
+        raise_error("Internal error: out of memory.");
 
-    fclose(fp);
+    refs->refs = new_refs;
+    refs->cap = new_cap;
 }
 
-void dump_entry_labels(LabelsTable *labels_tbl_ptr, char *of){
-    Label *lbl;
-    FILE *fp;
+void append_external_refs(ExternalRefs *dst, ExternalRefs *src){
+    if (src->cnt == 0)
+        return;
 
-    fp = fopen(of, "w");
+    reserve_external_refs(dst, src->cnt);
+    memcpy(dst->refs + dst->cnt, src->refs, src->cnt * sizeof(ExternalRef));
+    dst->cnt += src->cnt;
+}
 
-    /* Iterate over each label and print the label in the file if it's an entry */
-    while (labels_tbl_ptr != NULL){
-        /* Retrieve label */
-        lbl = labels_tbl_ptr->label;
+void group_external_refs(ExternalRefs *refs, int labels_cnt){
+    ExternalRef *grouped;
+    int *starts;
+    int i;
 
-        /* If the label is an entry, add it to the file in the right format */
-        if (lbl->is_entry){
-            fprintf(fp, "%s %04d\n", lbl->label, lbl->value);
-        }
-        /* Move on to the next node */
-        labels_tbl_ptr = labels_tbl_ptr->next;
+    refs->grouped = true;
+    if (refs->cnt == 0)
+        return;
+
+    grouped = (ExternalRef *) malloc(refs->cnt * sizeof(ExternalRef));
+    starts = (int *) calloc(labels_cnt + 1, sizeof(int));
+    if (grouped == NULL || starts == NULL){
+        free(grouped);
+        free(starts);
+        raise_error("Internal error: out of memory.");
     }
 
-    fclose(fp);
+    /* Counting sort on the label index: stable, so every group stays in address order */
+    for (i = 0; i < refs->cnt; i++)
+        starts[refs->refs[i].label + 1]++;
+    for (i = 0; i < labels_cnt; i++)
+        starts[i + 1] += starts[i];
+    for (i = 0; i < refs->cnt; i++)
+        grouped[starts[refs->refs[i].label]++] = refs->refs[i];
+
+    free(starts);
+    free(refs->refs);
+    refs->refs = grouped;
+    refs->cap = refs->cnt;
 }
 
-void rename_externals_file(char *new_filename){
-    rename(TMP_EXTERNALS_MMAP_FILE, new_filename);
-}
+void record_external_label(char *lbl_name, LabelsTable *labels_table_ptr, int frame_no, int line_no, ExternalRefs *refs){
+    Label *lbl;
 
-void reset_bitmap(BITMAP_32 *bitmap){
-    int i;
-    /* Iterate over the 31 bits and clear each one of them */
-    for (i=0; i <= 31; i++)
-        ClearBit(*bitmap, i);
+    lbl = get_label_by_name(labels_table_ptr, lbl_name);
+
+    if (lbl == NULL){
+        report("[x] Error on line %d, label %s doesn't exist\n", line_no, lbl_name);
+        raise_error(NULL);
+        return;
+    }
+
+    reserve_external_refs(refs, 1);
+    refs->refs[refs->cnt].label = lbl - labels_table_ptr->labels;
+    refs->refs[refs->cnt].addr = frame_no;
+    refs->cnt++;
 }
 
-void merge_tmp_data_file(char *dst_fname, int dc_offset){
-    BITMAP_32 *bitmap; /* Hold the bitmap to dump */
-    int frame_no; /* Hold the current line number */
-    char c; /* Hold   */
+void write_external_refs(ExternalRefs *refs, LabelsTable *tbl, Writer *w){
+    char *name, *out;
+    size_t len;
     int i;
-    FILE *fp;
 
-    bitmap = (BITMAP_32 *) calloc(1, sizeof(BITMAP_32));
+    /* "<name> <address>" per line, the address takes at most 10 digits */
+    for (i = 0; i < refs->cnt; i++){
+        name = get_label_name(tbl, &tbl->labels[refs->refs[i].label]);
+        len = strlen(name);
+        out = reserve_in_writer(w, len + OBJ_LINE_MAX_SIZE);
+        memcpy(out, name, len);
+        out[len] = ' ';
+        len += 1 + format_address(out + len + 1, refs->refs[i].addr);
+        out[len - 1] = '\n'; /* In place of the space after the address */
+        advance_writer(w, len);
+    }
+}
 
-    frame_no = dc_offset;
+void dump_external_refs(ExternalRefs *refs, LabelsTable *tbl, char *of){
+    Writer *w;
+
+    w = create_writer(of);
+    write_external_refs(refs, tbl, w);
+    close_writer(w);
+}
 
-    fp = fopen(TMP_DATA_MMAP_FILE, "r");
+void dump_entry_labels(LabelsTable *labels_tbl_ptr, char *of){
+    Label *lbl;
+    Writer *w;
+    char *name, *out;
+    int i;
 
-    i=0;
-    while ( (c = fgetc(fp)) != EOF){
-        if (c == '1')
-            SetBit(*bitmap, i);
+    w = create_writer(of);
 
-        i++;
+    /* Iterate over each label (in definition order) and print the label in the file if it's an entry */
+    for (i = 0; i < labels_tbl_ptr->count; i++){
+        /* Retrieve label */
+        lbl = &labels_tbl_ptr->labels[i];
 
-        /* Every 32 bits, dump the current bitmap and reset everything */
-        if (i == 32){
-            reverse_dump_bitmap(bitmap, dst_fname, frame_no, 4);
-            frame_no += 4;
-            reset_bitmap(bitmap);
-            i=0;
+        /* If the label is an entry, add it to the file in the right format ("<name> <address>", at most 11 digits) */
+        if (lbl->is_entry){
+            name = get_label_name(labels_tbl_ptr, lbl);
+            out = reserve_in_writer(w, strlen(name) + OBJ_LINE_MAX_SIZE);
+            advance_writer(w, sprintf(out, "%s %04d\n", name, lbl->value));
         }
     }
 
-    /* Dump the remaining bits */
-    if (i != 0)
-        reverse_dump_bitmap(bitmap, dst_fname, frame_no, (i%8)+1);
-
-}
-
-void create_tmp_files(){
-    fopen(TMP_DATA_MMAP_FILE, "w");
-    fopen(TMP_EXTERNALS_MMAP_FILE, "w");
-}
-
-void delete_tmp_files(){
-    remove(TMP_DATA_MMAP_FILE);
-    /* External tmp file is simply renamed */
+    close_writer(w);
 }
 
-int get_label_addr_dist(char *lbl_name, LabelsTable *labels_tbl_ptr, int frame_addr){
+int get_label_addr_dist(char *lbl_name, LabelsTable *labels_tbl_ptr, int frame_addr, int line_no){
     Label *lbl;
     int lbl_addr;
 
     /* Retrieve the right label */
     lbl = get_label_by_name(labels_tbl_ptr, lbl_name);
+    if (lbl == NULL){
+        report("[x] Error on line %d, label %s doesn't exist\n", line_no, lbl_name);
+        raise_error(NULL);
+    }
 
 	/* If the label is external, return 0 */
 	if (lbl->is_external == 1)
@@ -299,32 +413,21 @@ int get_label_addr_dist(char *lbl_name, LabelsTable *labels_tbl_ptr, int frame_a
     return lbl_addr - frame_addr;
 }
 
-BITMAP_32 *encode_instruction_line(char *line_ptr, LabelsTable *labels_table_ptr, int frame_no){
-	BITMAP_32 *bitmap;
-	InstructionsGroup instr_grp;
-	char cmd_name[5];
-
+WORD_32 encode_instruction_line(SourceLine *line, LabelsTable *labels_table_ptr, int frame_no, ExternalRefs *ext_refs){
+	WORD_32 word;
+	const Instruction *instr; /* The command of the line */
+	Token *ops; /* The operands of the line */
 	int opcode;
 	int rs,rt,rd; /* Hold registers numbers */
 	int immed, addr, funct_no; /* Integer buffers specific to each group*/
 	int is_reg = 0; /* register flag for J group */
-	char* token;
-	char* params; /* the cmd line without the cmd itself */
-
-    bitmap = (BITMAP_32 *) calloc(1, sizeof(BITMAP_32));
 
-	params = strchr(line_ptr, ' ');
-	if(params != NULL)
-	{
-		params = params + 1;
-	}
+	instr = line->instr;
+	ops = line->operands;
+	opcode = instr->opcode;
 
-	get_cmd_name(line_ptr, cmd_name);
-	opcode = get_opcode(cmd_name);
-	instr_grp = get_instruction_group(cmd_name);
-
-    /* Parse the line and encode it accordingly to the operation's group */
-	switch (instr_grp) {
+    /* Encode the line accordingly to the operation's group (the operands were checked by the first pass) */
+	switch (instr->group) {
 		/*
 		 * I group:
 		 * If the operation is one of bne, beq, blt or bgt,
@@ -332,77 +435,56 @@ BITMAP_32 *encode_instruction_line(char *line_ptr, LabelsTable *labels_table_ptr
 		 * else it will be in the format "OP $rs, Immed (const), $rt"
 		 */
         case I:
-            /* Parse first register */
-            token = strtok(params, ",");
-            rs = atoi(token+1);
-
-            if (STREQ(cmd_name, "bne") ||
-                STREQ(cmd_name, "beq") ||
-                STREQ(cmd_name, "blt") ||
-                STREQ(cmd_name, "bgt")
-                ){
-
-                /* Parse second register */
-                token = strtok(NULL, ",");
-                rt = atoi(token + 1);
+            rs = ops[0].value;
 
-                /* Parse the label */
-                token = strtok(NULL, ",");
-                immed = get_label_addr_dist(token, labels_table_ptr, frame_no);
+            if (instr->operands == REG_REG_LABEL){
+                rt = ops[1].value;
+                immed = get_label_addr_dist(ops[2].text, labels_table_ptr, frame_no, line->line_no);
 
 				/* Check if label is external */
 				if (immed == 0){
-                    printf("[x] Error on line %d, label of an I instruction should not be external", frame_no);
+                    report("[x] Error on line %d, label of an I instruction should not be external\n", line->line_no);
+                    raise_error(NULL);
+				}
+
+				/* The distance is signed, the label may be before or after the line */
+				if (immed < -(1L << (IMMEDIATE_BITS - 1)) || immed >= (1L << (IMMEDIATE_BITS - 1))){
+                    report("[x] Error on line %d, label %s is too far to branch to (distance %d)\n", line->line_no, ops[2].text, immed);
                     raise_error(NULL);
 				}
             }
             else{
-                /* Parse immed (constant) */
-                token = strtok(NULL, ",");
-                immed = atoi(token);
-
-                /* Parse rt */
-                token = strtok(NULL, ",");
-                rt = atoi(token+1);
+                immed = immediate_value(&ops[1]);
+                rt = ops[2].value;
             }
 
-            /* Build bitmap */
-            bitmap = build_I_instruction(opcode, rs, rt, immed);
+            /* Build the word */
+            word = build_I_instruction(opcode, rs, rt, immed);
             break;
 
 		/*
 		 * R group:
 		 * Every command with opcode 0 need 3 arguments, while commands
 		 * with opcode 1 only need 2.
-         * if (is_external_instruction(line_ptr))
-         * continue;
-         *
 		 */
         case R:
             /* Get function number required by R group instructions */
-            funct_no = get_function_id(cmd_name);
+            funct_no = instr->funct;
 
-            /* Parse first register */
-            token = strtok(params, ",");
-            rs = atoi(token+1);
+            rs = ops[0].value;
+            rt = ops[1].value;
 
-            /* Parse second register */
-            token = strtok(NULL, ",");
-            rt = atoi(token+1);
-
-            /* if opcode is 0, parse the third register*/
+            /* if the command takes 3 registers, parse the third one */
             /* Else set rd to be the second register and rt to be 0 */
-            if (opcode == 0){
-                token = strtok(NULL, ",");
-                rd = atoi(token+1);
-            }
+            if (instr->operands == THREE_REGISTERS)
+                rd = ops[2].value;
             else{
                 rd = rt;
                 rt = 0;
             }
 
-            /* Build final bitmap */
-            bitmap = build_R_instruction(opcode, rs, rt, rd, funct_no);
+            /* Build final word */
+            word = build_R_instruction(opcode, rs, rt, rd, funct_no);
             break;
 
 		/*
@@ -412,132 +494,83 @@ BITMAP_32 *encode_instruction_line(char *line_ptr, LabelsTable *labels_table_ptr
 		 * If the command is a LA or CALL command, then the parameter can
 		 * only be a label
 		 * If the command is a STOP command, then it's not followed by anything
-		 * and the bitmap will be full of 0, except for the opcode
+		 * and the word will be full of 0, except for the opcode
 		 */
         case J:
 
 			/* If - Command is stop */
-			if (STREQ(cmd_name, "stop"))
+			if (instr->operands == NO_OPERANDS)
 				addr = 0;
 
 			/* Else if - Command is jmp and the argument is a register */
-			else if (*params == '$' && STREQ(cmd_name, "jmp")){
-                is_reg = 1;					/* Turn the register flag on */
-                addr = atoi(params + 1);    /* Parse the value of the register index */
+			else if (ops[0].kind == REGISTER_TOKEN && instr->operands == LABEL_OR_REGISTER){
+                is_reg = 1;				/* Turn the register flag on */
+                addr = ops[0].value;	/* Value of the register index */
             }
 
 			/* Else - Command is not stop and the argument is a label */
 			else {
                 /* Set addr to be the address the label points on */
-                addr = get_label_addr(labels_table_ptr, params);
+                addr = get_label_addr(labels_table_ptr, ops[0].text, line->line_no);
                 if (addr == 0)
-                    tmp_dump_external_label(params, labels_table_ptr, frame_no);
+                    record_external_label(ops[0].text, labels_table_ptr, frame_no, line->line_no, ext_refs);
+                else if (addr >= (1L << ADDRESS_BITS)){
+                    report("[x] Error on line %d, address %d of label %s doesn't fit in the address field (%d bits)\n", line->line_no, addr, ops[0].text, ADDRESS_BITS);
+                    raise_error(NULL);
+                }
 
             }
 
-            /* Build final bitmap */
-            bitmap = build_J_instruction(opcode, is_reg, addr);
+            /* Build final word */
+            word = build_J_instruction(opcode, is_reg, addr);
             break;
         }
 
-	return bitmap;
+	return word;
 }
 
-void print_bitmap_32(BITMAP_32 *bitmap){
-    int i;
-
-    /* For each bit, if it's on print a 1, else print a 0 */
-    for (i=0; i <= 31; i++)
-        TestBit(*bitmap, i) ? printf("1") : printf("0");
-
-    printf("\n");
-}
-
-void add_obj_to_bitmap(int obj, int *start_ix, int size, BITMAP_32 *bitmap){
-    int bit_shift;
-
-    /*
-     * Do <size> times:
-     * Compute the next bit ix, if the bit is turned on, set the corresponding
-     * bit in the bitmap
-     */
-    for (bit_shift = size-1; bit_shift >= 0; bit_shift--){
-        if ( ((obj >> bit_shift) & 1) == 1 ) /* Compute the bit at this index */
-            SetBit(*bitmap, *start_ix); /* Set it in the bitmap if we need to */
-
-        (*start_ix)++; /* Increment index */
+WORD_32 add_field(WORD_32 word, long value, int size, int shift){
+    /* The value is either a signed or an unsigned number of <size> bits */
+    if (value < -(1L << (size - 1)) || value >= (1L << size)){
+        report("[x] Error: value %ld doesn't fit in a field of %d bits\n", value, size);
+        raise_error(NULL);
     }
-    /* (*start_ix)--; */
-}
-
-BITMAP_32 *build_R_instruction(int opcode, int rs, int rt, int rd, int funct_no) {
-    BITMAP_32 *bitmap;
-    int bit_ix;
-
-    bitmap = (BITMAP_32 *) calloc(1, sizeof(BITMAP_32));
-
-    /* Start at bit 0 (left one)*/
-    bit_ix = 0;
-
-    /* Encode opcode in 6 bits */
-    add_obj_to_bitmap(opcode, &bit_ix, 6, bitmap);
-
-    /* Encode rs in 5 bits */
-    add_obj_to_bitmap(rs, &bit_ix, 5, bitmap);
-
-    /* Encode rt in 5 bits */
-    add_obj_to_bitmap(rt, &bit_ix, 5, bitmap);
-
-    /* Encode rd in 5 bits */
-    add_obj_to_bitmap(rd, &bit_ix, 5, bitmap);
-
-    /* Encode funct_no in 5 bits */
-    add_obj_to_bitmap(funct_no, &bit_ix, 5, bitmap);
-
-    /* Return the bitmap */
-    return bitmap;
 
+    return word | (((WORD_32) value & ((1UL << size) - 1)) << shift);
 }
 
-BITMAP_32 *build_I_instruction(int opcode, int rs, int rt, int immed) {
-    BITMAP_32 *bitmap;
-    int bit_ix;
-
-    bitmap = (BITMAP_32 *) calloc(1, sizeof(BITMAP_32));
-    /* Start at bit 0 (left one)*/
-    bit_ix = 0;
-
-    /* Encode opcode in 6 bits */
-    add_obj_to_bitmap(opcode, &bit_ix, 6, bitmap);
+WORD_32 build_R_instruction(int opcode, int rs, int rt, int rd, int funct_no) {
+    WORD_32 word = 0;
 
-    /* Encode rs in 5 bits */
-    add_obj_to_bitmap(rs, &bit_ix, 5, bitmap);
+    /* <opcode (6) | rs (5) | rt (5) | rd (5) | funct_no (5) | Empty (5)> */
+    word = add_field(word, opcode, 6, 26);
+    word = add_field(word, rs, 5, 21);
+    word = add_field(word, rt, 5, 16);
+    word = add_field(word, rd, 5, 11);
+    word = add_field(word, funct_no, 5, 6);
 
-    /* Encode rt in 5 bits */
-    add_obj_to_bitmap(rt, &bit_ix, 5, bitmap);
-
-    /* Encode immed in 16 bits */
-    add_obj_to_bitmap(immed, &bit_ix, 16, bitmap);
-
-    return bitmap;
+    return word;
 }
 
-BITMAP_32 *build_J_instruction(int opcode, int is_reg, int addr) {
-    BITMAP_32 *bitmap;
-    int bit_ix;
+WORD_32 build_I_instruction(int opcode, int rs, int rt, int immed) {
+    WORD_32 word = 0;
 
-    bitmap = (BITMAP_32 *) calloc(1, sizeof(BITMAP_32));
-    /* Start at bit 0 (left one)*/
-    bit_ix = 0;
+    /* <opcode (6) | rs (5) | rt (5) | immed (16)> */
+    word = add_field(word, opcode, 6, 26);
+    word = add_field(word, rs, 5, 21);
+    word = add_field(word, rt, 5, 16);
+    word = add_field(word, immed, IMMEDIATE_BITS, 0);
 
-    /* Encode opcode in 6 bits */
-    add_obj_to_bitmap(opcode, &bit_ix, 6, bitmap);
+    return word;
+}
 
-    /* Encode register flag in 1 bit */
-    add_obj_to_bitmap(is_reg, &bit_ix, 1, bitmap);
+WORD_32 build_J_instruction(int opcode, int is_reg, int addr) {
+    WORD_32 word = 0;
 
-    /* Encode address in 25 bits */
-    add_obj_to_bitmap(addr, &bit_ix, 25, bitmap);
+    /* <opcode (6) | is_reg (1) | addr (25)> */
+    word = add_field(word, opcode, 6, 26);
+    word = add_field(word, is_reg, 1, 25);
+    word = add_field(word, addr, ADDRESS_BITS, 0);
 
-    return bitmap;
+    return word;
 }
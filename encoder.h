@@ -1,110 +1,230 @@
 #ifndef ENCODER_H
 #define ENCODER_H
 #include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include "labels.h"
+#include "instructions.h"
+#include "source.h"
+#include "writer.h"
 
-#define SetBit(A,k)     ( A[(k/32)] |= (1 << (k%32)) )
-#define ClearBit(A,k)   ( A[(k/32)] &= ~(1 << (k%32)) )
-#define TestBit(A,k)    ( A[(k/32)] & (1 << (k%32)) )
-
-typedef int BITMAP_32[2];
+/*
+ * An encoded instruction
+ * Bit 31 is the first bit of the opcode, bit 0 is the last bit of the instruction
+ */
+typedef uint32_t WORD_32;
 
 /*
- * Append 4 bytes in file
- * The last byte in the bitmap is the first to be printed
+ * Append an encoded instruction in file
+ * The lowest byte of the word is the first to be printed
  * Args:
- * bitmap - The bytes to dump
- * fname - Output filename
+ * word - The encoded instruction
+ * w - Writer of the output file
  * line_no - Number of the line that is dumped
- * bytes_to_dump - Number of bytes to read from the bitmap
  */
-void dump_bitmap(BITMAP_32 *bitmap, char *fname, int line_no, int bytes_to_dump);
+void dump_word(WORD_32 word, Writer *w, int line_no);
 
 /*
- * Append 4 bytes in file
- * The first byte in the bitmap is the first to be printed
+ * Append a whole section of encoded instructions in file, one per line
+ * The lines are formatted directly in the buffer of the writer
  * Args:
- * bitmap - The bytes to dump
- * fname - Output filename
- * line_no - Number of the line that is dumped
- * bytes_to_dump - Number of bytes to read from the bitmap
+ * words - The encoded instructions
+ * cnt - Number of instructions
+ * w - Writer of the output file
+ * first_addr - Address of the first instruction
  */
-void reverse_dump_bitmap(BITMAP_32 *bitmap, char *fname, int line_no, int bytes_to_dump);
+void dump_words(WORD_32 *words, int cnt, Writer *w, int first_addr);
 
 /*
- * Dump a data instruction (.db, .dh...) to a temporary file, as raw bits
- * Args:
- * line_ptr - instruction to dump
+ * Represent the data section of the memory, as raw bytes
+ *
+ * Attributes:
+ * bytes - Encoded data, in memory order
+ * len - Number of encoded bytes
+ * size - Number of allocated bytes
  */
-void tmp_dump_data_instruction(char *line_ptr);
+typedef struct DataImage{
+	unsigned char *bytes;
+	int len;
+	int size;
+} DataImage;
 
 /*
- * Add an external label to the temporary external labels file.
+ * Create an empty data image
+ *
  * Args:
- * lbl_name - Name of the label
- * labels_table_ptr - Labels table that map this label
- * frame_no - Number of the line where this external label is needed
+ * size - Expected number of bytes (DC calculated by the first pass), the image grows if needed
+ *
+ * Return:
+ * The data image
  */
-void tmp_dump_external_label(char *lbl_name, LabelsTable *labels_table_ptr, int frame_no);
+DataImage *create_data_image(int size);
 
 /*
- * Dump every entry labels to the entries output file (.ent)
- * The file is created from scratch
+ * Free a data image
  *
  * Args:
- * labels_tbl_ptr - The table mapping all the labels
- * of - Name of the output file containing the entries
+ * img - The data image to free
  */
-void dump_entry_labels(LabelsTable *labels_tbl_ptr, char *of);
+void free_data_image(DataImage *img);
 
 /*
- * Build an instruction of the R group in this format:
- * <opcode (6) | rs (5) | rt (5) | rd (5) | funct_no (5) | Empty (5)>
+ * Calculate the number of bytes required by a data instruction
  *
  * Args:
- * opcode - The command opcode
- * rs - register S
- * rt - register T
- * rd - register D
- * funct_no - The function id of the command
+ * line - Data line (.db, .dh...)
  *
  * Return:
- * A bitmap encoding the instruction
+ * The number of bytes that encode_data_instruction adds to the data image for <line>
  */
-BITMAP_32 *build_R_instruction(int opcode, int rs, int rt, int rd, int funct_no);
+int get_data_size(SourceLine *line);
 
 /*
- * Rename the temporary file containing the external labels into
- * a persistent one, with the right name.
- * :param external_of: Filename of the file containing the external labels
+ * Encode a data instruction (.db, .dh...) at the end of the data image
+ * Args:
+ * line - instruction to encode
+ * img - The data image
+ */
+void encode_data_instruction(SourceLine *line, DataImage *img);
+
+/*
+ * Append bytes at the end of a data image, growing it if needed
+ * Args:
+ * img - The data image
+ * bytes - The bytes
+ * len - Number of bytes
+ */
+void append_to_data_image(DataImage *img, unsigned char *bytes, int len);
+
+/*
+ * Dump the data image to the object file, 4 bytes per line
+ * Args:
+ * img - The data image
+ * w - Writer of the object file
+ * dc_offset - Address of the first data cell
+ */
+void dump_data_image(DataImage *img, Writer *w, int dc_offset);
+
+/*
+ * Represent a use of an external label by an instruction
+ *
+ * Attributes:
+ * label - Index of the external label in the labels table
+ * addr - Address of the instruction
+ */
+typedef struct ExternalRef{
+	int label;
+	int addr;
+} ExternalRef;
+
+/*
+ * Represent the external references of a file, collected in memory while it is encoded
+ *
+ * Attributes:
+ * refs - The references, in source order unless they are grouped
+ * cnt - Number of references
+ * cap - Number of allocated references
+ * grouped - True if the references are grouped by label (see group_external_refs)
+ */
+typedef struct ExternalRefs{
+	ExternalRef *refs;
+	int cnt;
+	int cap;
+	bool grouped;
+} ExternalRefs;
+
+/*
+ * Create an empty vector of external references
+ * An error is raised if there is no memory
+ *
+ * Return:
+ * The vector
  */
-void rename_externals_file(char *external_of);
+ExternalRefs *create_external_refs();
 
 /*
- * Clear every bit in a bitmap
+ * Free a vector of external references
  *
  * Args:
- * bitmap - the bitmap to clear
+ * refs - The vector to free
  */
-void reset_bitmap(BITMAP_32 *bitmap);
+void free_external_refs(ExternalRefs *refs);
 
 /*
- * Merge the temporary data file to the real .ob file
- * Also convert the raw bits written in the temporary data file
- * to the hexadecimal format of the object file
+ * Append the references of a vector at the end of another one
+ * Args:
+ * dst - The vector appended to
+ * src - The appended vector (left as is)
+ */
+void append_external_refs(ExternalRefs *dst, ExternalRefs *src);
+
+/*
+ * Group the references by label: the groups follow the order of the labels in the table,
+ * the references of a label stay in source order
+ * Args:
+ * refs - The references
+ * labels_cnt - Number of labels in the labels table
+ */
+void group_external_refs(ExternalRefs *refs, int labels_cnt);
+
+/*
+ * Record the use of an external label by an instruction
+ * An error is raised if the label doesn't exist
+ * Args:
+ * lbl_name - Name of the label
+ * labels_table_ptr - Labels table that map this label
+ * frame_no - Address of the instruction using the label
+ * line_no - Number of the source line of the instruction (for the messages)
+ * refs - Where the reference is recorded
  */
-void merge_tmp_data_file();
+void record_external_label(char *lbl_name, LabelsTable *labels_table_ptr, int frame_no, int line_no, ExternalRefs *refs);
 
 /*
- * Create all the temporary files needed for the encoding
+ * Write external references to a writer of an externals file, one per line
+ *
+ * Args:
+ * refs - The references
+ * tbl - The labels table
+ * w - The writer
  */
-void create_tmp_files();
+void write_external_refs(ExternalRefs *refs, LabelsTable *tbl, Writer *w);
 
 /*
- * Delete all the temporary files that were needed for the encoding
+ * Write the external references to the externals output file (.ext), one per line, in one buffered write
+ * The file is created from scratch
+ *
+ * Args:
+ * refs - The references
+ * tbl - The labels table
+ * of - Name of the output file containing the external references
+ */
+void dump_external_refs(ExternalRefs *refs, LabelsTable *tbl, char *of);
+
+/*
+ * Dump every entry labels to the entries output file (.ent)
+ * The file is created from scratch
+ *
+ * Args:
+ * labels_tbl_ptr - The table mapping all the labels
+ * of - Name of the output file containing the entries
  */
-void delete_tmp_files();
+void dump_entry_labels(LabelsTable *labels_tbl_ptr, char *of);
 
+/*
+ * Build an instruction of the R group in this format:
+ * <opcode (6) | rs (5) | rt (5) | rd (5) | funct_no (5) | Empty (5)>
+ *
+ * Args:
+ * opcode - The command opcode
+ * rs - register S
+ * rt - register T
+ * rd - register D
+ * funct_no - The function id of the command
+ *
+ * Return:
+ * The encoded instruction
+ */
+WORD_32 build_R_instruction(int opcode, int rs, int rt, int rd, int funct_no);
 
 /*
  * Return the difference between a label's address and the current frame index
@@ -112,43 +232,41 @@ void delete_tmp_files();
  * lbl_name - Name of the label
  * labels_tbl_ptr - Table mapping this label
  * frame_addr - Address on which the distance should be calculated
+ * line_no - Number of the source line using the label (for the messages)
  *
  * Return:
  * The distance between the label's address and the frame address (in bytes)
  */
-int get_label_addr_dist(char *lbl_name, LabelsTable *labels_tbl_ptr, int frame_addr);
+int get_label_addr_dist(char *lbl_name, LabelsTable *labels_tbl_ptr, int frame_addr, int line_no);
 
 /*
- * Translate a line instruction into bit maps, following the format needed by each instruction
+ * Translate a line instruction into a word, following the format needed by each instruction
  *
  * Args:
- * line_ptr - Line to parse
+ * line - Code line to encode
  * labels_tbl_ptr - Table that map labels
  * addr - address of the instruction line (IC)
+ * ext_refs - Where the uses of external labels are recorded
  *
  * Return:
- * A bitmap representing the encoded line
+ * The encoded line
  */
-BITMAP_32 *encode_instruction_line(char *line_ptr, LabelsTable *labels_tbl_ptr, int addr);
+WORD_32 encode_instruction_line(SourceLine *line, LabelsTable *labels_tbl_ptr, int addr, ExternalRefs *ext_refs);
 
 /*
- * Print the content of a bitmap
+ * Add a field to an encoded instruction
+ * An error is raised if the value doesn't fit in the field
  *
  * Args:
- * bitmap - The bitmap to print
- */
-void print_bitmap_32(BITMAP_32 *bitmap);
-
-/*
- * Add an integer to a bitmap at a given index, the size of the obj can vary (up to 32 bits)
+ * word - The encoded instruction
+ * value - Value of the field (negative values are written in two's complement)
+ * size - Size of the field in bits (from 1 to 31)
+ * shift - Index of the last bit of the field in the word (0 is the last bit of the instruction)
  *
- * Args:
- * obj - The obj to add
- * start_ix - Pointer to the start index where the obj should be added (from 0 to 31)
- * size - Size in bits of the added object (from 1 to 32)
- * bitmap - The bitmap where the object should be added
+ * Return:
+ * <word> with the field added
  */
-void add_obj_to_bitmap(int obj, int *start_ix, int size, BITMAP_32 *bitmap);
+WORD_32 add_field(WORD_32 word, long value, int size, int shift);
 
 /*
  * Build an instruction of the I group in this format:
@@ -161,9 +279,9 @@ void add_obj_to_bitmap(int obj, int *start_ix, int size, BITMAP_32 *bitmap);
  * immed - Immed field
  *
  * Return:
- * A bitmap encoding the instruction
+ * The encoded instruction
  */
-BITMAP_32 *build_I_instruction(int opcode, int rs, int rt, int immed);
+WORD_32 build_I_instruction(int opcode, int rs, int rt, int immed);
 
 /*
  * Build an instruction of the R group in this format:
@@ -175,9 +293,9 @@ BITMAP_32 *build_I_instruction(int opcode, int rs, int rt, int immed);
  * addr - Address to use
  *
  * Return:
- * A bitmap encoding the instruction
+ * The encoded instruction
  */
-BITMAP_32 *build_J_instruction(int opcode, int is_reg, int addr);
+WORD_32 build_J_instruction(int opcode, int is_reg, int addr);
 
 
 
@@ -1,8 +1,11 @@
 /*
  * Error checking functions
  */
+#define _POSIX_C_SOURCE 200112L
 
 #include <stdlib.h>
+#include <stdarg.h>
+#include <setjmp.h>
 #include <ctype.h>
 #include "utils.h"
 #include "errors.h"
@@ -10,233 +13,184 @@
 #include "encoder.h"
 #include "instructions.h"
 #include "labels.h"
+#include "source.h"
+#include "context.h"
+
+#define REPORT_MAX_SIZE 1024
 
 void raise_error(char* msg)
 {
+    Context *ctx;
+
     if (msg != NULL)
-        printf("%s\n", msg);
+        report("%s\n", msg);
+
+    /* Inside a context, only the assembling of the current file is stopped */
+    ctx = get_current_context();
+    if (ctx != NULL)
+        longjmp(ctx->on_error, 1);
+
     printf("Exiting with code 1.\n");
 	exit(1);
 }
 
-bool check_file(char *fname){
-    FILE *fp;
-    int error_raised, line_no;
-	size_t read_cnt; /* Number of character retrieved on a line */
-    char *line_ptr;
-    char *label = (char *) calloc(LINE_MAX_SIZE, sizeof(char));
-    char *cmd;
-	size_t line_len;
-
-	line_len = LINE_MAX_SIZE;
-
-    fp = fopen(fname, "r");
-    if (fp == NULL){
-		printf("[x] Bad file: %s\n", fname);
-        raise_error(NULL);
+void report(char *fmt, ...)
+{
+    Context *ctx;
+    va_list args;
+    char msg[REPORT_MAX_SIZE];
+    int len;
+
+    va_start(args, fmt);
+
+    /* Messages of a file are kept in its context so that they are printed in order */
+    ctx = get_current_context();
+    if (ctx == NULL)
+        vprintf(fmt, args);
+    else{
+        len = vsnprintf(msg, REPORT_MAX_SIZE, fmt, args);
+        if (len >= REPORT_MAX_SIZE)
+            len = REPORT_MAX_SIZE - 1;
+        if (len > 0)
+            add_to_log(ctx, msg, len);
     }
 
-    error_raised = line_no = 0;
-    line_ptr = (char *) calloc(LINE_MAX_SIZE, sizeof(char));
+    va_end(args);
+}
 
-	while ((read_cnt = get_line_wout_spaces(&line_ptr, &line_len, fp)) != -1) {
+/*
+ * Find the command of a line as written: its first word after the label
+ * (the lexed mnemonic is truncated, and empty if the line starts with a comma or a quote)
+ *
+ * Args:
+ * line - The line
+ * buf - Buffer where the word is written (at least <line->len> + 1 characters)
+ *
+ * Return:
+ * The word, in <buf>
+ */
+static char *get_raw_command(SourceLine *line, char *buf){
+    char *word, *end;
 
-		cmd = (char *) calloc(CMD_MAX_SIZE, sizeof(char));
-        ++line_no;
+    get_raw_line(line, buf);
 
+    /* A label never holds a colon, the first one ends it */
+    word = line->label != NULL ? strchr(buf, LABEL_CHAR) + 1 : buf;
+    word = trim_whitespaces(word);
 
-        if (!relevant_line(line_ptr))
-            continue;
+    for (end = word; *end != '\0' && *end != WHITESPACE; end++) {}
+    *end = '\0';
+    return word;
+}
 
-        /* Check several errors: */
+bool check_line(SourceLine *line){
+    bool valid;
+    char *raw; /* The line as read, for the messages */
 
-        /* Error 1 - Line is too long */
-        if (read_cnt >= LINE_MAX_SIZE){
-            printf("[x] Error on line %d: line too long (%lu chars, maximum is 80)\n", line_no, read_cnt);
-            error_raised = 1;
-        }
+    if (line->kind == IRRELEVANT_LINE)
+        return true;
 
-        /* Error 2 - Line contains open quotes */
-        if (open_quotes(line_ptr)){
-            printf("[x] Error on line %d: Invalid syntax - <%s> (quote left open)\n", line_no, line_ptr);
-            error_raised = 1;
-        }
+    valid = true;
 
-        /* Error 3 - The line contains a colon but no label */
-        if (!validate_prefix(line_ptr)){
-            printf("[x] Error on line %d: Invalid syntax - <%s> (label name is empty)\n", line_no, line_ptr);
-			line_ptr++; /* Skip the colon to check more errors */
-            error_raised = 1;
-        }
+    /* Rebuild the line as read, only if a message quotes it */
+    raw = NULL;
+    if (line->open_quote || (line->label != NULL && *line->label == '\0') || line->double_comma){
+        raw = (char *) ctx_calloc(line->len + 1, sizeof(char));
+        get_raw_line(line, raw);
+    }
 
-        /* Error 4 - double commas */
-        if (!validate_commas(line_ptr)){
-            printf("[x] Error on line %d: Invalid syntax - <%s> (consecutive commas)\n", line_no, line_ptr);
-            error_raised = 1;
-        }
+    /* Check several errors: */
 
-        /* Error 5 - If there is a label, check that it's not a forbidden word */
-        if (contain_label(line_ptr)){
-            label = get_label(line_ptr);
-            if (!validate_label(label, line_no))
-                error_raised = 1;
+    /* Error 1 - Line is too long */
+    if (line->raw_len >= LINE_MAX_SIZE){
+        report("[x] Error on line %d: line too long (%d chars, maximum is 80)\n", line->line_no, line->raw_len);
+        valid = false;
+    }
 
-			line_ptr = trim_label(line_ptr);
-        }
+    /* Error 2 - Line contains open quotes */
+    if (line->open_quote){
+        report("[x] Error on line %d: Invalid syntax - <%s> (quote left open)\n", line->line_no, raw);
+        valid = false;
+    }
 
-        /* Error 6 - Check that the data instruction is valid */
-        if (is_data_instruction(line_ptr)){
-            if (!validate_data_instruction(line_ptr, line_no)){
-                error_raised = 1;
-            }
-        }
+    /* Error 3 - The line contains a colon but no label */
+    if (line->label != NULL && *line->label == '\0'){
+        report("[x] Error on line %d: Invalid syntax - <%s> (label name is empty)\n", line->line_no, raw);
+        valid = false;
+    }
 
-        /* If it's a code instruction */
-        if (is_code_instruction(line_ptr)){
-            get_cmd_name(line_ptr, cmd);
-            /* Error 7 - Check that the command exists */
-			if (!command_exists(cmd)){
-                printf("[x] Error on line %d: Command <%s> doesn't exist.\n", line_no, cmd);
-                error_raised = 1;
-            }
-			else{
-				/* Error 8 - Check that the number of arguments match the command requirements */
-				if (!check_number_of_args(line_ptr, line_no)){
-					error_raised = 1;
-                    continue;
-                }
-
-
-				/* Error 9 - Check that the registers name are right */
-				if (!check_registers(line_ptr, line_no)){
-					error_raised=1;
-                    continue;
-                }
-
-			}
-        }
+    /* Error 4 - double commas */
+    if (line->double_comma){
+        report("[x] Error on line %d: Invalid syntax - <%s> (consecutive commas)\n", line->line_no, raw);
+        valid = false;
     }
-    /* If any error occured, the file cannot be parsed, stop execution */
-    if (error_raised == 1)
-		return false;
-	return true;
-}
 
-bool open_quotes(char* line_ptr)
-{
-	int quotes_counter = 0; /* count the qoutes in the line */
+    /* Error 5 - If there is a label, check that it's not a forbidden word */
+    if (line->label != NULL && *line->label != '\0'){
+        if (!validate_label(line->label, line->line_no))
+            valid = false;
+    }
 
-	char* current_char = line_ptr; /* initialize the current char pointer */
+    /* Error 6 - Check that the data instruction is valid */
+    if (line->kind == DATA_LINE){
+        if (!validate_data_instruction(line))
+            valid = false;
+    }
 
-	char quote = '"';
+    /* Error 7 - .entry and .extern take exactly one label */
+    if (line->kind == ENTRY_LINE || line->kind == EXTERNAL_LINE){
+        if (!check_number_of_args(line))
+            valid = false;
+    }
 
-	while (*current_char)
-	{
-		if (quote == *current_char) /* character is a quote */
-			quotes_counter++;
+    /* If it's a code instruction */
+    if (line->kind == CODE_LINE){
+        /* Error 8 - Check that the command exists */
+        if (line->instr == NULL){
+            report("[x] Error on line %d: Command <%s> doesn't exist.\n", line->line_no,
+                   get_raw_command(line, (char *) ctx_calloc(line->len + 1, sizeof(char))));
+            return false;
+        }
 
-		current_char++;
-	}
+        /* Error 9 - Check that the number of arguments match the command requirements */
+        if (!check_number_of_args(line))
+            return false;
 
-	/* if the number of quotes in the line is even then all quotes are closed */
-	if (quotes_counter % 2 != 0)
-		return true;
-	return false;
-}
+        /* Error 10 - Check that the registers name are right */
+        if (!check_registers(line))
+            return false;
 
-bool validate_prefix(char* line_ptr)
-{
-	if (*line_ptr == ':')
-		return false;
-	return true;
+        /* Error 11 - Check that the immediates fit in their field */
+        if (!check_immediates(line))
+            return false;
+    }
+
+    return valid;
 }
 
-bool check_number_of_args(char* line_ptr, int line_no){
-	char* cmd; /* the command name */
-	char* args; /* the command arguments */
-	int cmd_opcode;
+bool check_number_of_args(SourceLine *line){
 	int required_args;
-	int args_counter = 0; /* count the given argumetns */
-	char* token; /* for strtok and counting the args */
-
-	cmd = (char *) calloc(80, sizeof(char));
-	get_cmd_name(line_ptr, cmd);
 
-	args = (char *) calloc(80, sizeof(char));
-	strcpy(args, line_ptr + strlen(cmd));
+	/* Directives (.entry and .extern) take one label */
+	required_args = line->instr != NULL ? get_operands_count(line->instr) : 1;
 
-	cmd_opcode = get_opcode(cmd);
-
-	token = strtok(args, ",");
-	while (token != NULL)
-	{
-		args_counter++;
-		token = strtok(NULL, ",");
-	}
-
-	if (cmd_opcode == 0) /* R instructions - 3 operands */
-		required_args = 3;
-	else if (cmd_opcode == 1) /* R instructions - 2 operands */
-		required_args = 2;
-	else if (cmd_opcode >= 10 && cmd_opcode <= 24) /* I instrcution */
-		required_args = 3;
-	else if (cmd_opcode >= 30 && cmd_opcode <= 62) /* J instrcution */
-		required_args = 1;
-	else if (cmd_opcode == 63)
-		required_args = 0;
-
-	if (args_counter != required_args){
-		printf("[x] Error on line %d: Bad number of parameters (Actual: %d, expected: %d)\n", line_no, args_counter, required_args);
+	if (line->operands_cnt != required_args){
+		report("[x] Error on line %d: Bad number of parameters (Actual: %d, expected: %d)\n", line->line_no, line->operands_cnt, required_args);
 		return false;
 	}
 
 	return true;
 }
 
-bool validate_commas(char* line_ptr)
-{
-	char* cmd; /* the command name */
-	char* args; /* the command arguments */
-	int comma_found = 0;
-	char* current_char;
-
-	cmd = (char *) calloc(80, sizeof(char));
-	get_cmd_name(line_ptr, cmd);
-
-	args = (char *) calloc(80, sizeof(char));
-	strcpy(args, line_ptr + strlen(cmd));
-	current_char = args;
-
-	/* Iterate over every character and check for doubled commas */
-	while (*current_char)
-	{
-		if (*current_char == ',')
-		{
-			/* If a comma was already found, then commas are consecutive */
-			if (comma_found == 1)
-				return false;
-
-			comma_found = 1; /* a comma is found */
-		}
-		/* Any non-space character cancel the comma flag */
-		else if ( !isspace(*current_char))
-			comma_found = 0;
-
-		current_char++;
-	}
-
-	return true;
-}
-
 bool is_reserved_word(char* word)
 {
-	if (get_opcode(word) != -1) /* if there's an opcode for the word, it's a reserved one */
+	if (lookup_instruction(word) != NULL) /* if the word is a command, it's a reserved one */
 		return true;
 	return false;
 }
 
 bool command_exists(char *cmd_name){
-    if (get_opcode(cmd_name) == -1){
+    if (lookup_instruction(cmd_name) == NULL){
         return false;
     }
     return true;
@@ -248,112 +202,96 @@ bool validate_label(char *lbl_name, int line_no){
 	/* Check that the label contain only alphanumeric characters */
 	while (lbl_name[i]){
 		if ( !isalnum(lbl_name[i++]) ){
-            printf("[x] Error on line %d: Bad Label <%s>, labels can contain only alphanumeric characters\n", line_no, lbl_name);
+            report("[x] Error on line %d: Bad Label <%s>, labels can contain only alphanumeric characters\n", line_no, lbl_name);
 			return false;
         }
 	}
 
     /* Check if the label is a reserved word */
     if (is_reserved_word(lbl_name)){
-        printf("[x] Error on line %d: Bad Label, <%s> is a reserved word\n", line_no, lbl_name);
+        report("[x] Error on line %d: Bad Label, <%s> is a reserved word\n", line_no, lbl_name);
         return false;
     }
 
 	return true;
 }
 
-bool check_registers(char *line_ptr, int line_no){
-    int val;
-    char *token;
-    char *params;
+bool check_registers(SourceLine *line){
+    Token *tok;
+    int i;
     bool valid;
 
     valid = true;
 
-	params = strchr(line_ptr, ' ');
-	if(params != NULL)
-	{
-		params = params + 1;
-	}
+    for (i = 0; i < line->operands_cnt; i++){
+        tok = &line->operands[i];
+        if (tok->kind != REGISTER_TOKEN)
+            continue;
+
+        /* $0 is the only register whose number reads as 0 */
+        if (tok->value == 0 && tok->text[1] != '0'){
+            report("[x] Error on line %d: Register %s is invalid (it should be a number between 0 and 31)\n", line->line_no, tok->text);
+            valid = false;
+        }
 
-    token = strtok(params, ",");
-
-    while (token){
-        if (*token == '$'){
-            if (*(token+1) == '0')
-                val = 0;
-            else{
-                val = atoi(token+1);
-                if (val == 0){
-                    printf("[x] Error on line %d: Register %s is invalid (it should be a number between 0 and 31)\n", line_no, token);
-                    valid = false;
-                }
-            }
-
-            if ( val < 0 || val > 31){
-                printf("[x] Error on line %d: Register %s is not in range (should be between 0 and 31)\n", line_no, token);
-                valid = false;
-            }
+        if (tok->value < 0 || tok->value > 31){
+            report("[x] Error on line %d: Register %s is not in range (should be between 0 and 31)\n", line->line_no, tok->text);
+            valid = false;
         }
-		token = strtok(NULL, ",");
     }
     return valid;
 }
 
-
-bool validate_data_instruction(char *line_ptr, int line_no){
-    char *token; /* Used for strtok */
-    char *instruction_name; /* Name of the data instruction */
-    char *params; /* Parameters of the lines */
-    int size; /* Size of the encoded word in bits */
-    int val; /* Temporary variable */
-    int max_val; /* Hold the maximum value of a data point */
-    int valid;
+bool check_immediates(SourceLine *line){
+    Token *tok;
+    int i;
+    bool valid;
 
     valid = true;
 
-	instruction_name = get_instruction(line_ptr);
+    /* Like the encoder, a field takes a signed or an unsigned number of IMMEDIATE_BITS bits */
+    for (i = 0; i < line->operands_cnt; i++){
+        tok = &line->operands[i];
+        if (tok->kind != IMMEDIATE_TOKEN)
+            continue;
 
-	params = (char *) calloc(LINE_MAX_SIZE, sizeof(char));
-	strcpy(params, line_ptr + strlen(instruction_name));
-	params = trim_whitespaces(params);
+        if (tok->value < -(1L << (IMMEDIATE_BITS - 1)) || tok->value >= (1L << IMMEDIATE_BITS)){
+            report("[x] Error on line %d: value %d doesn't fit in the immediate field (%d bits)\n", line->line_no, tok->value, IMMEDIATE_BITS);
+            valid = false;
+        }
+    }
+    return valid;
+}
 
-    /* Skip the operation name */
-    while ( !isspace(*line_ptr++) ) {}
+bool validate_data_instruction(SourceLine *line){
+    Token *tok;
+    int size; /* Size of the encoded word in bits */
+    long max_val; /* Hold the maximum value of a data point */
+    int i, val;
+    bool valid;
 
-    /* Skip every trailing whitespace (even if there shouldn't be) */
-    while ( isspace(*line_ptr) )
-        line_ptr++;
+    valid = true;
 
-    if (!(STREQ(instruction_name, ".asciz"))){
-        /* Encode every number  */
-        if (STREQ(instruction_name, ".db")){
-            size = 8;
-            max_val = 127;
-        }
-        else if (STREQ(instruction_name, ".dh")){
-            size = 16;
-            max_val = 32767;
-        }
-        else{ /* instruction is .dw*/
-            size = 32;
-            max_val = 2147483647;
+    /* .asciz takes one string */
+    if (line->directive->value_size == 0){
+        if (line->operands_cnt != 1 || line->operands[0].kind != STRING_TOKEN){
+            report("[x] Error on line %d: %s expects one string\n", line->line_no, line->directive->name);
+            valid = false;
         }
+        return valid;
+    }
 
-		token = strtok(params, ",");
-		while (token)
-		{
-            val = atoi(token);
-            if (val < -(max_val+1) || val > max_val){
-                printf("[x] Error on line %d: value %d is too big for %s command (%d bits)\n", line_no, val, instruction_name, size);
-                valid = false;
-            }
-
-			token = strtok(NULL, ",");
-		}
+    size = 8 * line->directive->value_size;
+    max_val = (1L << (size - 1)) - 1;
+
+    for (i = 0; i < line->operands_cnt; i++){
+        tok = &line->operands[i];
+        val = tok->kind == IMMEDIATE_TOKEN ? tok->value : 0;
+        if (val < -(max_val+1) || val > max_val){
+            report("[x] Error on line %d: value %d is too big for %s command (%d bits)\n", line->line_no, val, line->directive->name, size);
+            valid = false;
+        }
     }
 
     return valid;
-
 }
-
@@ -5,60 +5,48 @@
 #include <stdio.h>
 #include <string.h>
 #include "labels.h"
+#include "source.h"
 
 /*
-This method prints a proper error message.
+This method prints a proper error message and stops the assembling.
+When called inside a context (see context.h), only the assembling of the
+current file is stopped, else the program exits.
 Args:
 msg - the message to display.
 */
 void raise_error(char* msg);
 
 /*
- * Check if any syntax error appear in a file
+ * Print a message (printf format)
+ * When called inside a context, the message is added to the log of the
+ * context instead, so that the messages of every file are printed in order
+ *
  * Args:
- * fname - Name of the file to check
+ * fmt - Format of the message
  */
-bool check_file(char *fname);
+void report(char *fmt, ...);
 
 /*
-This method checks if there are open quotes in the line.
-It counts the total number of quotes and checks if it's even.
-Args:
-line_ptr - the line to check.
-Return:
-true if open quotes are found and false if not.
-*/
-bool open_quotes(char* line_ptr);
-
-/*
-This method checks a there is a colon (:) without a label in the line.
-It checks if the first character in the line is a colon.
-Args:
-:param line_ptr: the line to check.
-:Return: True if the line is valid else false
-*/
-bool validate_prefix(char* line_ptr);
+ * Check if any syntax error appear in a parsed line, every error found is reported
+ * (called by the first pass on each line, see first_pass.h)
+ *
+ * Args:
+ * line - The parsed line to check
+ *
+ * Return:
+ * True if the line has no error
+ */
+bool check_line(SourceLine *line);
 
 /*
 This method checks if the command has the proper number of arguments.
 Args:
-line_ptr - Line to parse
-line_no - Number of the parsed line
+line - Code line to check (its command must exist), or .entry/.extern line (one label expected)
 
 Return:
 true if the given number of args is valid and false if not.
 */
-bool check_number_of_args(char* line_ptr, int line_no);
-
-/*
-This method checks all comma-realted errors: commas at beginning or end,
-or consecutive commas.
-Args:
-line_ptr - the line to validate.
-Return:
-true if there are no comma-related error and false if not.
-*/
-bool validate_commas(char* line_ptr);
+bool check_number_of_args(SourceLine *line);
 
 /*
 This method checks if a specific word is a reserved word. It's used to check label names
@@ -98,24 +86,35 @@ bool validate_label(char *lbl_name, int line_no);
  * Check that they are numbers and in the right range
  *
  * Args:
- * line_ptr - The line to parse
- * line_no - Number of the parsed line
+ * line - The line to check
+ *
+ * Return
+ * True if everything went right else false
+ */
+bool check_registers(SourceLine *line);
+
+/*
+ * Check the immediates of a code instruction line
+ * Check that each of them fits in the immediate field of the encoded word
+ *
+ * Args:
+ * line - The line to check
  *
  * Return
  * True if everything went right else false
  */
-bool check_registers(char *line_ptr, int line_no);
+bool check_immediates(SourceLine *line);
 
 /*
  * Validate a data instruction
- * Check that the numbers passed are in the right range
+ * Check that the numbers passed are in the right range, and that .asciz is given a string
  *
  * Args:
- * line_ptr - Line to parse
+ * line - Data line to check
  *
  * Return:
  * true if it's valid else false
  */
-bool validate_data_instruction(char *line_ptr, int line_no);
+bool validate_data_instruction(SourceLine *line);
 
 #endif
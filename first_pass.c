@@ -8,123 +8,374 @@
 
 #include "errors.h"
 #include "instructions.h"
+#include "encoder.h"
 #include "utils.h"
 #include "globals.h"
 #include "labels.h"
-#include "second_pass.h"
+#include "source.h"
+#include "context.h"
+#include "chunks.h"
+#include "stream.h"
+
 
 /*
- * Boolean flags
- * has_label - True if the line contain a label
- * is_data_instruction - True if the line is a data instruction
+ * Check that a label is not defined yet
+ *
+ * Args:
+ * tbl - The labels table
+ * name - Name of the label
+ * line_no - Number of the line defining the label
+ *
+ * Return:
+ * False (the error is reported) if the label is already defined
  */
-typedef struct Flags{
-    unsigned int has_label : 1;
-    unsigned int is_data_instruction : 1;
-} Flags;
+static bool is_new_label(LabelsTable *tbl, char *name, int line_no){
+    if (get_label_by_name(tbl, name) == NULL)
+        return true;
 
+    report("[x] Error on line %d: Label <%s> is already defined\n", line_no, name);
+    return false;
+}
 
-void first_pass(char *fname){
-    Flags flags;
+/*
+ * Check a line and count the memory it takes
+ *
+ * Args:
+ * line - The line
+ * ic - Instruction counter, incremented by the size of a code line
+ * dc - Data counter, incremented by the size of a data line
+ *
+ * Return:
+ * False if the line has errors (it is not counted)
+ */
+static bool count_line(SourceLine *line, int *ic, int *dc){
+    /* Check the line, a line with errors is not labelled (the file won't be encoded anyway) */
+    if (!check_line(line))
+        return false;
 
-	FILE *fp; /* File pointer */
-	char *line_ptr; /* Line holder buffer */
-	size_t line_len; /* Max Length of a line in a file */
-	size_t read_cnt; /* Number of character retrieved on a line */
+    if (line->kind == DATA_LINE)
+        *dc += get_data_size(line);
+    else if (line->kind == CODE_LINE)
+        *ic += 4;
+    return true;
+}
 
-    int ic, dc; /* Instruction counter, Data counter */
-    char *label, *var_name; /* Store temporary strings */
+/*
+ * Add the label defined by a checked line to the labels table
+ *
+ * Args:
+ * tbl - The labels table
+ * line - The line
+ * ic - Instruction counter at the beginning of the line
+ * dc - Data counter at the beginning of the line
+ *
+ * Return:
+ * False (the error is reported) if the label is already defined
+ */
+static bool define_label(LabelsTable *tbl, SourceLine *line, int ic, int dc){
+    char *name;
 
-	LabelsTable *labels_table; /* Holds the list of labels */
+    switch (line->kind) {
+        /* Labels of data lines point on the data counter */
+        case DATA_LINE:
+            if (line->label == NULL)
+                return true;
+            if (!is_new_label(tbl, line->label, line->line_no))
+                return false;
+            label_data_instruction(tbl, dc, line->label);
+            return true;
 
-	/* Init variables */
-    ic = 100; /* IC always start from 100 */
-    dc = 0;
-    line_ptr = (char *) calloc(LINE_MAX_SIZE, sizeof(char));
-	line_len = LINE_MAX_SIZE;
+        /* An external instruction defines its variable */
+        case EXTERNAL_LINE:
+            name = line->operands[0].text;
+            if (!is_new_label(tbl, name, line->line_no))
+                return false;
+            add_external_variable(tbl, name);
+            return true;
 
-	labels_table = (LabelsTable *) calloc(1, sizeof(LabelsTable));
+        /* Labels of code lines point on the instruction counter */
+        case CODE_LINE:
+            if (line->label == NULL)
+                return true;
+            if (!is_new_label(tbl, line->label, line->line_no))
+                return false;
+            label_code_instruction(tbl, ic, line->label);
+            return true;
 
-	/* Open file */
-	fp = fopen(fname, "r");
+        /* Irrelevant lines and .entry instructions (taken care of in the 2nd pass) define nothing */
+        default:
+            return true;
+    }
+}
 
-	/* Check if the file is valid */
-	if (!fp){
-		printf("Bad file: %s\n", fname);
-        raise_error(NULL);
-	}
+/*
+ * Check if a line defines a label
+ */
+static bool defines_label(SourceLine *line){
+    return line->kind == EXTERNAL_LINE || ((line->kind == DATA_LINE || line->kind == CODE_LINE) && line->label != NULL);
+}
+
+/*
+ * A label defined in a chunk, added to the table once the addresses of the chunk are known
+ *
+ * Attributes:
+ * line_ix - Index of the line defining the label
+ * ic - Instruction counter of the chunk at the beginning of the line
+ * dc - Data counter of the chunk at the beginning of the line
+ * log_pos - Length of the log of the chunk after the line was checked
+ */
+typedef struct LabelDef{
+	int line_ix;
+	int ic;
+	int dc;
+	size_t log_pos;
+} LabelDef;
+
+/*
+ * Result of the first pass over a chunk
+ *
+ * Attributes:
+ * defs - Labels defined in the chunk, in line order (allocated with malloc)
+ * defs_cnt - Number of labels
+ * ic - Size of the code of the chunk
+ * dc - Size of the data of the chunk
+ * is_valid - False if a line of the chunk has errors
+ */
+typedef struct ChunkCounters{
+	LabelDef *defs;
+	int defs_cnt;
+	int ic;
+	int dc;
+	bool is_valid;
+} ChunkCounters;
+
+/*
+ * Free the labels recorded by a chunk
+ */
+static void free_chunk_counters(Chunk *chunk){
+    free(((ChunkCounters *) chunk->data)->defs);
+}
+
+/*
+ * Check and count the lines of a chunk, from counters starting at 0
+ * The labels are only recorded, with their offsets in the chunk
+ */
+static void count_chunk(Chunk *chunk){
+    ChunkCounters *cnt;
+    SourceLine *line;
+    ArenaMark line_mark;
+    int i;
 
-	/* Loop - Read lines and parse them */
-	while ((read_cnt = get_line_wout_spaces(&line_ptr, &line_len, fp)) != -1) {
+    cnt = (ChunkCounters *) chunk->data;
 
-        /* Reinitialize flags */
-        flags.has_label = flags.is_data_instruction = 0;
+    /* A chunk can't define more labels than it has lines */
+    cnt->defs = (LabelDef *) malloc((chunk->end_line - chunk->first_line) * sizeof(LabelDef));
+    if (cnt->defs == NULL)
+        raise_error("Internal error: out of memory.");
 
-        /* Clean the string */
-        line_ptr = clean_str(line_ptr);
+    line_mark = ctx_mark();
+    for (i = chunk->first_line; i < chunk->end_line; i++){
+        line = &chunk->src->lines[i];
+        ctx_release(line_mark);
 
-        /* Ignore every irrelevant line (comments/empty/etc..) */
-        if (!relevant_line(line_ptr))
+        if (!count_line(line, &cnt->ic, &cnt->dc)){
+            cnt->is_valid = false;
             continue;
+        }
 
-        /* If the line is labelled, mark it and parse the label, then skip it */
-        if (contain_label(line_ptr)){
-            flags.has_label = 1; /* Mark the presence of the label */
-            label = get_label(line_ptr); /* Parse the label */
-            line_ptr = trim_label(line_ptr); /* Skip the label */
+        if (defines_label(line)){
+            cnt->defs[cnt->defs_cnt].line_ix = i;
+            cnt->defs[cnt->defs_cnt].ic = cnt->ic - (line->kind == CODE_LINE ? 4 : 0);
+            cnt->defs[cnt->defs_cnt].dc = cnt->dc - (line->kind == DATA_LINE ? get_data_size(line) : 0);
+            cnt->defs[cnt->defs_cnt].log_pos = chunk->ctx->log_len;
+            cnt->defs_cnt++;
         }
+    }
+}
+
+/*
+ * First pass over chunks of lines on worker threads: each chunk is checked and counted on its own,
+ * then the counters of the chunks are summed up in order to give every chunk its first address,
+ * and the labels of the chunks are added to the table in line order.
+ * The messages of the chunks are merged in line order, with the duplicate labels
+ *
+ * Args:
+ * ctx - Context of the file
+ * src - The source file
+ * tbl - The labels table
+ * chunks - The chunks of <src>
+ * chunks_cnt - Number of chunks
+ * ic, dc - Where the counters of the whole file are written (<ic> starts at 100)
+ *
+ * Return:
+ * False if the file has errors
+ */
+static bool first_pass_chunks(Context *ctx, SourceFile *src, LabelsTable *tbl, Chunk *chunks, int chunks_cnt, int *ic, int *dc){
+    ChunkCounters *counters;
+    LabelDef *def;
+    Context *chunk_ctx;
+    size_t log_pos;
+    int i, j, done;
+    bool is_valid;
 
-        /*
-         * Handle data instruction commands:
-         * Calculate how many cells this data instruction will need
-         * Label it if we need to
-         */
-        if (is_data_instruction(line_ptr)){
-            flags.is_data_instruction = 1; /* Mark the line as data instruction */
+    counters = (ChunkCounters *) ctx_calloc(chunks_cnt, sizeof(ChunkCounters));
+    for (i = 0; i < chunks_cnt; i++){
+        counters[i].is_valid = true;
+        chunks[i].data = &counters[i];
+        chunks[i].free_data = free_chunk_counters;
+    }
 
-            /* If the line contains a label, add it to the labels table */
-            if (flags.has_label){
-                label_data_instruction(labels_table, dc, label);
-            }
+    done = run_chunks(chunks, chunks_cnt, ctx->line_workers, count_chunk);
 
-            /* Update Data Counter */
-            dc += get_required_cells(line_ptr);
+    is_valid = true;
+    for (i = 0; i < done; i++){
+        chunk_ctx = chunks[i].ctx;
+        log_pos = 0;
 
-            /* Go to next line */
-            continue;
+        /* Prefix sum: the chunk starts where the previous chunks end */
+        for (j = 0; j < counters[i].defs_cnt; j++){
+            def = &counters[i].defs[j];
+
+            /* Messages of the lines before the label, then the label itself */
+            add_to_log(ctx, chunk_ctx->log + log_pos, def->log_pos - log_pos);
+            log_pos = def->log_pos;
+
+            if (!define_label(tbl, &src->lines[def->line_ix], *ic + def->ic, *dc + def->dc))
+                is_valid = false;
         }
+        add_to_log(ctx, chunk_ctx->log + log_pos, chunk_ctx->log_len - log_pos);
 
-        /* If it's a .entry instruction, ignore it (We will take care of it in the 2nd pass) */
-        if (is_entry_instruction(line_ptr))
-            continue;
+        *ic += counters[i].ic;
+        *dc += counters[i].dc;
+        is_valid = is_valid && counters[i].is_valid;
+    }
+
+    /* Keep the messages of the chunk that failed, the chunks are freed with the pass */
+    if (done < chunks_cnt){
+        add_to_log(ctx, chunks[done].ctx->log, chunks[done].ctx->log_len);
+        raise_error(NULL);
+    }
+
+    free_chunks(chunks, chunks_cnt);
+    return is_valid;
+}
 
-        /* Handle external instruction */
-        if (is_external_instruction(line_ptr)){
+/*
+ * Check the lines of a source file in order, count them and define their labels
+ *
+ * Args:
+ * src - The lines
+ * tbl - The labels table
+ * ic - Instruction counter, incremented by the code lines
+ * dc - Data counter, incremented by the data lines
+ *
+ * Return:
+ * False if a line has errors
+ */
+static bool check_lines(SourceFile *src, LabelsTable *tbl, int *ic, int *dc){
+    SourceLine *line; /* Current parsed line */
+    ArenaMark line_mark; /* Arena position before each line, the memory used by a line is released after it */
+    int line_ic, line_dc; /* Counters at the beginning of the current line */
+    bool is_valid;
+    int i;
 
-            /* Extract the variable name from the line */
-            var_name = parse_external_var_name(line_ptr);
+    is_valid = true;
+    line_mark = ctx_mark();
+    for (i = 0; i < src->lines_cnt; i++){
+        line = &src->lines[i];
+        ctx_release(line_mark);
 
-            /* Add this instruction as an external label */
-            add_external_variable(labels_table, var_name);
+        line_ic = *ic;
+        line_dc = *dc;
+        if (!count_line(line, ic, dc)){
+            is_valid = false;
             continue;
         }
 
-        /* If we get here, it's an code instruction */
-        if (flags.has_label) /* If there is a label, add it */
-            label_code_instruction(labels_table, ic, label);
-
-        ic += 4;
+        if (!define_label(tbl, line, line_ic, line_dc))
+            is_valid = false;
     }
+    return is_valid;
+}
+
+bool first_pass(SourceFile *src){
+    bool is_valid; /* False once an error is found */
+
+    int ic, dc; /* Instruction counter, Data counter */
+
+	LabelsTable *labels_table; /* Holds the list of labels */
+    Context *ctx; /* Context of the file */
+    Chunk *chunks; /* Chunks of lines of a big file, NULL if the file is not split */
+    int chunks_cnt;
+
+    start_phase(ctx_stats(), FIRST_PASS_PHASE);
+
+	/* Init variables */
+    ic = 100; /* IC always start from 100 */
+    dc = 0;
+    is_valid = true;
+
+	labels_table = create_labels_table();
+    ctx = get_current_context();
+    ctx->labels = labels_table; /* Kept for the second pass, freed by the context if the assembling stops */
+
+    /* Big files are checked on several threads */
+    chunks = create_chunks(src, ctx->line_workers, &chunks_cnt);
+    if (chunks != NULL)
+        is_valid = first_pass_chunks(ctx, src, labels_table, chunks, chunks_cnt, &ic, &dc);
+
+	/* Loop - Go over the parsed lines */
+    if (chunks == NULL && !check_lines(src, labels_table, &ic, &dc))
+        is_valid = false;
 
     /*
      * Because we want to put every data definition at the end
      * of the binary output file, add IC to every labelled data
      */
-    add_data_offset(labels_table, ic);
+    if (is_valid)
+        add_data_offset(labels_table, ic);
+
+    ctx->ic_size = ic - 100;
+    ctx->dc_size = dc;
+    end_phase(ctx_stats(), FIRST_PASS_PHASE);
+
+    return is_valid;
+}
+
+bool first_pass_stream(char *fname){
+    SourceStream *st; /* The file, read through a window */
+    SourceFile *window; /* Lines of the current window */
+    bool is_valid; /* False once an error is found */
+    int ic, dc; /* Instruction counter, Data counter */
+	LabelsTable *labels_table; /* Holds the list of labels */
+    Context *ctx; /* Context of the file */
+
+    start_phase(ctx_stats(), FIRST_PASS_PHASE);
+
+    ic = 100; /* IC always start from 100 */
+    dc = 0;
+    is_valid = true;
+
+	labels_table = create_labels_table();
+    ctx = get_current_context();
+    ctx->labels = labels_table; /* Kept for the second pass, freed by the context if the assembling stops */
+
+    /* Only the labels and the counters outlive a window */
+    st = open_source_stream(fname);
+    while ((window = next_source_window(st)) != NULL)
+        if (!check_lines(window, labels_table, &ic, &dc))
+            is_valid = false;
+
+    if (ctx_stats() != NULL)
+        ctx_stats()->lines = st->lines_cnt;
+    close_source_stream(st);
+
+    if (is_valid)
+        add_data_offset(labels_table, ic);
 
-	/* Close the file */
-	fclose(fp);
+    ctx->ic_size = ic - 100;
+    ctx->dc_size = dc;
+    end_phase(ctx_stats(), FIRST_PASS_PHASE);
 
-    /* Start second pass */
-    second_pass(fname, labels_table, ic-100, dc);
+    return is_valid;
 }
@@ -2,15 +2,30 @@
 #define FIRST_PASS_H
 
 #include <stdbool.h>
+#include "source.h"
 
 /*
- * Perform first pass on a file:
+ * Perform first pass on a file, in a single scan of its lines:
+ * - Check each line for errors, every error of the file is reported
  * - Saving each defined/used label into a labels table
  * - Calculate IC and DC counters in order to build a
  *   memory map and calculate the address of each label
+ * The labels table and the counters are kept in the current context
+ * (labels, ic_size and dc_size) for the second pass
  *
- * :param fname: Name of the file to parse
+ * :param src: The parsed file
+ * :return: True if the file has no error (it can be encoded by the second pass)
  */
-void first_pass(char *fname);
+bool first_pass(SourceFile *src);
+
+/*
+ * Perform the first pass on a file streamed through a window of lines (see stream.h)
+ * Every line is checked as by first_pass, but only the labels table and the counters are kept
+ * The number of lines is recorded in the statistics of the file
+ *
+ * :param fname: Name of the file
+ * :return: True if the file has no error (it can be encoded by second_pass_stream)
+ */
+bool first_pass_stream(char *fname);
 
 #endif
@@ -0,0 +1,89 @@
+/*
+ * Generator of the instructions lookup table
+ * Find a seed for which the hash of every mnemonic of instructions.def falls in a distinct slot,
+ * then print the table (to be saved as instructions_table.h)
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "mnemonic_hash.h"
+
+#define MIN_SLOTS 32
+#define MAX_SLOTS 1024
+#define MAX_SEEDS 1000000UL
+
+/*
+ * Instruction as written in instructions.def
+ */
+typedef struct InstructionDef{
+	char *mnemonic;
+	char *group;
+	int opcode;
+	int funct;
+	char *operands;
+} InstructionDef;
+
+#define INSTRUCTION(mnemonic, group, opcode, funct, operands) {mnemonic, #group, opcode, funct, #operands},
+static InstructionDef defs[] = {
+#include "instructions.def"
+};
+#undef INSTRUCTION
+
+#define DEFS_CNT ((int) (sizeof(defs) / sizeof(defs[0])))
+
+/*
+ * Check if a seed places every mnemonic in a distinct slot
+ *
+ * Args:
+ * seed - Seed of the hash
+ * slots_cnt - Number of slots of the table
+ * slots - Filled with the index of the instruction of each slot (-1 if free)
+ *
+ * Return:
+ * 1 if there is no collision else 0
+ */
+static int try_seed(unsigned long seed, int slots_cnt, int *slots){
+    int i, slot;
+
+    for (i = 0; i < slots_cnt; i++)
+        slots[i] = -1;
+
+    for (i = 0; i < DEFS_CNT; i++){
+        slot = hash_mnemonic(defs[i].mnemonic, seed) % slots_cnt;
+        if (slots[slot] != -1)
+            return 0;
+        slots[slot] = i;
+    }
+    return 1;
+}
+
+int main(void){
+    int slots[MAX_SLOTS];
+    int slots_cnt, i;
+    unsigned long seed;
+
+    /* Try the smallest tables first */
+    for (slots_cnt = MIN_SLOTS; slots_cnt <= MAX_SLOTS; slots_cnt *= 2)
+        for (seed = 1; seed <= MAX_SEEDS; seed++)
+            if (try_seed(seed, slots_cnt, slots))
+                goto found;
+
+    fprintf(stderr, "gen_instructions_table: no perfect hash found\n");
+    return 1;
+
+found:
+    printf("/*\n * Instructions lookup table, generated by gen_instructions_table from instructions.def\n * Do not edit\n */\n");
+    printf("#define INSTRUCTIONS_HASH_SEED %luUL\n", seed);
+    printf("#define INSTRUCTIONS_SLOTS %d\n\n", slots_cnt);
+    printf("static const Instruction instructions_table[INSTRUCTIONS_SLOTS] = {\n");
+    for (i = 0; i < slots_cnt; i++){
+        if (slots[i] == -1)
+            printf("\t{\"\", I, -1, 0, NO_OPERANDS},\n");
+        else
+            printf("\t{\"%s\", %s, %d, %d, %s},\n", defs[slots[i]].mnemonic, defs[slots[i]].group,
+                   defs[slots[i]].opcode, defs[slots[i]].funct, defs[slots[i]].operands);
+    }
+    printf("};\n");
+
+    return 0;
+}
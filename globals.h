@@ -4,12 +4,17 @@
 #ifndef GLOBALS_H
 #define GLOBALS_H
 
+/* Version of the assembler, part of the cache keys: change it whenever the outputs change */
+#define ASSEMBLER_VERSION "1.5"
+
 #define TRUE 1
 #define FALSE 0
 #define LINE_MAX_SIZE 81
 #define CMD_MAX_SIZE 4
 #define WHITESPACE ' '
 #define COMMENT_CHAR ';'
+#define IMMEDIATE_BITS 16 /* Size of the immediate field of an I instruction */
+#define ADDRESS_BITS 25 /* Size of the address field of a J instruction */
 
 #define STREQ(x,y) strcmp(x,y)==0?1:0
 
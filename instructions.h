@@ -2,6 +2,7 @@
 #define INSTRUCTIONS_H
 
 #include <stdbool.h>
+#include "globals.h"
 
 /*
  * Instructions groups - R, I and J
@@ -13,128 +14,91 @@ typedef enum {
 } InstructionsGroup;
 
 /*
- * Check if a line is a data instruction
- *
- * Args:
- * line_ptr - Line to parse
- *
- * Return:
- * True if a line is a data instruction line else false
+ * Operands expected by a command
  */
-bool is_data_instruction(char *line_ptr);
+typedef enum {
+	NO_OPERANDS,		/* stop */
+	THREE_REGISTERS,	/* $rs, $rt, $rd */
+	TWO_REGISTERS,		/* $rs, $rd */
+	REG_IMMED_REG,		/* $rs, immed, $rt */
+	REG_REG_LABEL,		/* $rs, $rt, label */
+	LABEL_OR_REGISTER,	/* label or $reg */
+	LABEL_OPERAND		/* label */
+} OperandsShape;
 
 /*
- * Return the name of the instruction in a line
- *
- * Args:
- * line_ptr - Line to parse
- *
- * Return:
- * Data instruction in the line
+ * Describe a command of the instruction set (see instructions.def)
+ *
+ * Attributes:
+ * mnemonic - Name of the command
+ * group - Instructions group of the command
+ * opcode - Opcode of the command
+ * funct - Function id of the command (only used by the R group)
+ * operands - Operands expected by the command
  */
-char *get_instruction(char *line_ptr);
+typedef struct Instruction{
+	char mnemonic[CMD_MAX_SIZE + 1];
+	InstructionsGroup group;
+	int opcode;
+	int funct;
+	OperandsShape operands;
+} Instruction;
 
 /*
- * Check if a line is an .entry instruction
- *
- * Args:
- * line_ptr - Line to parse
- *
- * Return:
- * True if a line is an entry instruction
+ * Kinds of directives
  */
-bool is_entry_instruction(char *line_ptr);
-
-/*
- * Check if a line is a .external instruction
- *
- * Args:
- * line_ptr - Line to parse
- *
- * Return:
- * True if a line is an external instruction
- */
-bool is_external_instruction(char *line_ptr);
-
-/*
- * Parse the variable of an .external instruction
- *
- * Args:
- * line_ptr - Line to parse
- *
- * Return:
- * The name of the external variable
- */
-char *parse_external_var_name(char *line_ptr);
+typedef enum {
+	DATA_DIRECTIVE,
+	ENTRY_DIRECTIVE,
+	EXTERN_DIRECTIVE
+} DirectiveKind;
 
 /*
- * Calculate the number of bytes required by a line
+ * Describe a directive (see the table in instructions.c)
  *
- * Args:
- * line_ptr - Line to parse
- *
- * Return:
- * The number of required memory cells by an instruction line
- * (each cell is 4 bytes)
+ * Attributes:
+ * name - Name of the directive, with its dot
+ * kind - Kind of the directive
+ * value_size - Size of each value of a data directive in bytes, 0 for a string (.asciz) and the other kinds
  */
-int get_required_cells(char *line_ptr);
+typedef struct Directive{
+	char *name;
+	DirectiveKind kind;
+	int value_size;
+} Directive;
 
 /*
- * Check if a line is relevant
+ * Find the description of a command
+ * The table is indexed by a perfect hash of the mnemonics, so it takes one hash and one compare
  *
  * Args:
- * line_ptr - The line to parse
+ * cmd_name - Name of the command
  *
  * Return:
- * False if a line is irrelevant (empty or commented out) else True
- */
-bool relevant_line(char *line_ptr);
-
-/*
- * Parse the command name in an instruction line and put it in <buf>
- *
- * Args:
- * line_ptr - The instruction line string
- * buf - Buffer where the command name will be written
+ * The description of <cmd_name>, NULL if the command doesn't exist
  */
-void get_cmd_name(char *line_ptr, char *buf);
+const Instruction *lookup_instruction(const char *cmd_name);
 
 /*
- * Return the instruction group of a command
+ * Find the description of a directive
  *
  * Args:
- * cmd - The command name
+ * name - Name of the directive, with its dot
  *
  * Return:
- * The instruction group associated with <cmd>
+ * The description of <name>, NULL if the directive doesn't exist
  */
-InstructionsGroup get_instruction_group(char *cmd);
+const Directive *lookup_directive(const char *name);
 
 /*
- * Return the opcode associated with a command
- * Args:
- * cmd - The command
- *
- * Return:
- * The opcode of <cmd>
- */
-int get_opcode(char *cmd);
-
-/*
- * Return the function id of an instruction (required by instructions of group R)
+ * Return the number of operands of a command
  *
  * Args:
- * cmd_name - Name of the instruction (should be of group R)
+ * instr - The command
  *
  * Return:
- * function id associated with <cmd_name>
- */
-int get_function_id(char *cmd_name);
-
-/*
- * Check if an instruction is a code instruction.
- * Actually check if a lineis not all the other types of lines
+ * The number of operands expected by <instr>
  */
-bool is_code_instruction(char *line_ptr);
+int get_operands_count(const Instruction *instr);
 
 #endif
@@ -0,0 +1,84 @@
+/*
+ * Pool of worker threads
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <pthread.h>
+#include "jobs.h"
+
+/*
+ * State shared by the workers of a pool
+ *
+ * Attributes:
+ * func - The function to run on each job
+ * jobs - The jobs
+ * jobs_cnt - Number of jobs
+ * next_job - Index of the next job to take
+ * lock - Protects <next_job>
+ */
+typedef struct Pool{
+	void (*func)(void *);
+	void **jobs;
+	int jobs_cnt;
+	int next_job;
+	pthread_mutex_t lock;
+} Pool;
+
+/*
+ * Worker loop: take the next job until there are no more jobs
+ */
+static void *worker(void *arg){
+    Pool *pool = (Pool *) arg;
+    int job_ix;
+
+    while (1){
+        pthread_mutex_lock(&pool->lock);
+        job_ix = pool->next_job++;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (job_ix >= pool->jobs_cnt)
+            break;
+
+        pool->func(pool->jobs[job_ix]);
+    }
+    return NULL;
+}
+
+void run_jobs(void (*func)(void *), void **jobs, int jobs_cnt, int workers_cnt){
+    Pool pool;
+    pthread_t *threads;
+    int i, started;
+
+    pool.func = func;
+    pool.jobs = jobs;
+    pool.jobs_cnt = jobs_cnt;
+    pool.next_job = 0;
+
+    if (workers_cnt > jobs_cnt)
+        workers_cnt = jobs_cnt;
+
+    threads = workers_cnt > 1 ? (pthread_t *) calloc(workers_cnt, sizeof(pthread_t)) : NULL;
+
+    /* Single worker (or no memory for threads): run on the calling thread */
+    if (threads == NULL){
+        for (i = 0; i < jobs_cnt; i++)
+            func(jobs[i]);
+        return;
+    }
+
+    pthread_mutex_init(&pool.lock, NULL);
+
+    /* The calling thread works too if a thread cannot be started */
+    for (started = 0; started < workers_cnt; started++)
+        if (pthread_create(&threads[started], NULL, worker, &pool) != 0)
+            break;
+    if (started == 0)
+        worker(&pool);
+
+    for (i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    pthread_mutex_destroy(&pool.lock);
+    free(threads);
+}
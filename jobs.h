@@ -0,0 +1,20 @@
+/*
+ * Pool of worker threads
+ */
+#ifndef JOBS_H
+#define JOBS_H
+
+/*
+ * Run a function on every job, using a pool of worker threads
+ * The jobs are taken in order by the first available worker,
+ * the function returns when every job is done
+ *
+ * Args:
+ * func - The function to run on each job
+ * jobs - The jobs
+ * jobs_cnt - Number of jobs
+ * workers_cnt - Number of worker threads (1 to run everything on the calling thread)
+ */
+void run_jobs(void (*func)(void *), void **jobs, int jobs_cnt, int workers_cnt);
+
+#endif
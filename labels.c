@@ -2,120 +2,148 @@
  * Labels creator and handlers
  */
 #include <stdlib.h>
-#include <ctype.h>
 #include "errors.h"
 #include "globals.h"
 #include "labels.h"
 #include "utils.h"
+#include "context.h"
 
-bool contain_label(char *s){
-    while (*s){
-        if (*s++ == ':')
-            return true;
+/*
+ * Initial sizes of the labels table
+ * SLOTS_INIT_CNT must be a power of 2
+ */
+#define LABELS_INIT_CAPACITY 64
+#define SLOTS_INIT_CNT 128
+#define NAMES_INIT_SIZE 4096
+
+/*
+ * Hash a label name (FNV-1a)
+ */
+static unsigned long hash_name(char *name){
+    unsigned long h = 2166136261UL;
+
+    while (*name){
+        h ^= (unsigned char) *name++;
+        h *= 16777619UL;
     }
-    return false;
+    return h;
 }
 
-char *get_label(char *line) {
-	char* label;
+/*
+ * Return the slot where <name> is stored, or the empty slot where it should be inserted
+ */
+static int find_slot(LabelsTable *tbl_ptr, char *name){
+    int mask, ix;
 
-	/*strtok changes the string */
- 	char* line_cpy = (char *) calloc(LINE_MAX_SIZE, sizeof(char));
-	strcpy(line_cpy, line);
+    mask = tbl_ptr->slots_cnt - 1;
+    ix = (int) (hash_name(name) & mask);
 
-	label = strtok(line_cpy, ":"); /* parse the label */
-	return label;
+    /* Linear probing until the label or an empty slot is found */
+    while (tbl_ptr->slots[ix] != 0){
+        if (STREQ(tbl_ptr->names + tbl_ptr->labels[tbl_ptr->slots[ix] - 1].name, name))
+            return ix;
+        ix = (ix + 1) & mask;
+    }
+    return ix;
 }
 
-char *get_entry_label(char *line_ptr){
-    char *ret;
-	char *s = (char *) calloc(LINE_MAX_SIZE, sizeof(char)); /* Running ptr */
-
-    ret = s;	/* ret hold the beginning address of s */
-
-	/* Jump to the next word */
-	while ( !isspace(*line_ptr) ) /* Move to next whitespace */
-        line_ptr++;
-	while ( isspace(*line_ptr) ) /* Move to next char */
-        line_ptr++;
+/*
+ * Double the number of slots and reindex every label
+ */
+static void grow_slots(LabelsTable *tbl_ptr){
+    int i;
 
-	/* Copy the next word */
-	while ( *line_ptr && !isspace(*line_ptr) )
-		*s++ = *line_ptr++;
+    free(tbl_ptr->slots);
+    tbl_ptr->slots_cnt *= 2;
+    tbl_ptr->slots = (int *) calloc(tbl_ptr->slots_cnt, sizeof(int));
+    if (tbl_ptr->slots == NULL)
+        raise_error("Internal error: cannot grow the labels table.");
 
-	return ret;
+    for (i = 0; i < tbl_ptr->count; i++)
+        tbl_ptr->slots[find_slot(tbl_ptr, tbl_ptr->names + tbl_ptr->labels[i].name)] = i + 1;
 }
 
-char *trim_label(char *line){
-	/* Move the pointer after the colon */
-	while (*line++ != LABEL_CHAR) {}
+/*
+ * Copy a name at the end of the names pool of the table, growing the pool if needed
+ *
+ * Return:
+ * Position of the copy in the pool
+ */
+static int intern_name(LabelsTable *tbl_ptr, char *name){
+    char *new_names;
+    int len, pos;
+
+    len = strlen(name) + 1;
+    while (tbl_ptr->names_len + len > tbl_ptr->names_size){
+        tbl_ptr->names_size *= 2;
+        new_names = (char *) realloc(tbl_ptr->names, tbl_ptr->names_size);
+        if (new_names == NULL)
+            raise_error("Internal error: cannot intern a label name.");
+        tbl_ptr->names = new_names;
+    }
 
-	/* Remove every extra whitespaces */
-	line = trim_whitespaces(line);
-	return line;
+    pos = tbl_ptr->names_len;
+    memcpy(tbl_ptr->names + pos, name, len);
+    tbl_ptr->names_len += len;
+    return pos;
 }
 
-void add_label_to_table(LabelsTable *tbl_ptr, Label *label){
-	LabelsTable *last_node;
-	LabelsTable *new_node;
+LabelsTable *create_labels_table(){
+    LabelsTable *tbl_ptr;
 
-	if (tbl_ptr == NULL || label == NULL)
-		return;
+    tbl_ptr = (LabelsTable *) calloc(1, sizeof(LabelsTable));
+    if (tbl_ptr == NULL)
+        raise_error("Internal error: cannot create the labels table.");
 
-    /* Initialize last_node on the beginning of the table */
-	last_node = tbl_ptr;
+    tbl_ptr->capacity = LABELS_INIT_CAPACITY;
+    tbl_ptr->labels = (Label *) malloc(tbl_ptr->capacity * sizeof(Label));
+    tbl_ptr->slots_cnt = SLOTS_INIT_CNT;
+    tbl_ptr->slots = (int *) calloc(tbl_ptr->slots_cnt, sizeof(int));
+    tbl_ptr->names_size = NAMES_INIT_SIZE;
+    tbl_ptr->names = (char *) malloc(tbl_ptr->names_size);
 
-    /* If the table is empty, add the new node as the first node */
-    if (last_node->label == NULL){
-        last_node->label = label;
-        return;
+    if (tbl_ptr->labels == NULL || tbl_ptr->slots == NULL || tbl_ptr->names == NULL){
+        free_labels_table(tbl_ptr);
+        raise_error("Internal error: cannot create the labels table.");
     }
 
-    /* Else if the table is not empty, go through it until the last node */
-	while (last_node->next != NULL){
-		/* Check that a label with the same name doesn't already exist */
-		if (STREQ(last_node->label->label, label->label)){
-			printf("Label with name %s already exist.\n", label->label);
-			raise_error(NULL);
-		}
-		last_node = last_node->next;
-	}
+    return tbl_ptr;
+}
+
+void free_labels_table(LabelsTable *tbl_ptr){
+    if (tbl_ptr == NULL)
+        return;
 
-    /* Create a new node containing the label */
-	new_node = (LabelsTable *) calloc(1, sizeof(LabelsTable));
-	new_node->label = label;
-	new_node->next = NULL;
+    free(tbl_ptr->labels);
+    free(tbl_ptr->slots);
+    free(tbl_ptr->names);
+    free(tbl_ptr);
+}
 
-    /* Add the new node as the next node of the last node */
-	last_node->next = new_node;
-    return;
+char *get_label_name(LabelsTable *tbl_ptr, Label *label){
+    return tbl_ptr->names + label->name;
 }
 
 Label *get_label_by_name(LabelsTable *tbl_ptr, char *name){
-    LabelsTable *curr_node;
+    int slot;
+
     if (tbl_ptr == NULL || name == NULL)
         return NULL;
 
-    curr_node = tbl_ptr;
-    while (curr_node){
-
-        /* If the node's label's name match, return it */
-        if (STREQ(curr_node->label->label, name))
-            return curr_node->label;
+    slot = find_slot(tbl_ptr, name);
 
-        /* Else move on to the next node */
-        curr_node = curr_node->next;
-    }
+    /* No matching label has been found */
+    if (tbl_ptr->slots[slot] == 0)
+        return NULL;
 
-    /* No matching node has been found */
-    return NULL;
+    return &tbl_ptr->labels[tbl_ptr->slots[slot] - 1];
 }
 
-int get_label_addr(LabelsTable *tbl_ptr, char *name){
+int get_label_addr(LabelsTable *tbl_ptr, char *name, int line_no){
     Label *lbl;
     lbl = get_label_by_name(tbl_ptr, name);
     if (lbl == NULL){
-        printf("Label %s doesn't exist\n", name);
+        report("[x] Error on line %d, label %s doesn't exist\n", line_no, name);
         raise_error(NULL);
     }
 
@@ -127,14 +155,14 @@ int get_label_addr(LabelsTable *tbl_ptr, char *name){
     return lbl->value;
 }
 
-void mark_label_as_entry(LabelsTable *tbl, char *name){
+void mark_label_as_entry(LabelsTable *tbl, char *name, int line_no){
     Label *label;
 
     /* Get the right label */
     label = get_label_by_name(tbl, name);
 
 	if (label == NULL){
-		printf("Entry %s doesn't match any label.\n", name);
+		report("[x] Error on line %d, entry %s doesn't match any label\n", line_no, name);
 		raise_error(NULL);
 	}
 
@@ -143,21 +171,40 @@ void mark_label_as_entry(LabelsTable *tbl, char *name){
 
 Label *create_label(LabelsTable *tbl_ptr, int addr, char *name, int is_code, int is_entry, int is_external){
     Label *label;
+    Label *new_labels;
+    int slot;
+
+    if (name == NULL)
+        name = "";
+
+    /* Check that a label with the same name doesn't already exist */
+    slot = find_slot(tbl_ptr, name);
+    if (tbl_ptr->slots[slot] != 0){
+        report("Label with name %s already exist.\n", name);
+        raise_error(NULL);
+    }
 
-    /* Create a label */
-	label = (Label *) calloc(1, sizeof(Label));
+    /* Grow the labels array if it is full */
+    if (tbl_ptr->count == tbl_ptr->capacity){
+        tbl_ptr->capacity *= 2;
+        new_labels = (Label *) realloc(tbl_ptr->labels, tbl_ptr->capacity * sizeof(Label));
+        if (new_labels == NULL)
+            raise_error("Internal error: cannot grow the labels table.");
+        tbl_ptr->labels = new_labels;
+    }
 
-    /* Set members values */
+    /* Add the label at the end of the array and index it */
+    label = &tbl_ptr->labels[tbl_ptr->count++];
+    label->name = intern_name(tbl_ptr, name);
 	label->value = addr;
 	label->is_code = is_code;
 	label->is_entry = is_entry;
 	label->is_external = is_external;
+    tbl_ptr->slots[slot] = tbl_ptr->count;
 
-    if (name)
-	    strcpy(label->label, name);
-
-    /* Add this label to the labels table */
-    add_label_to_table(tbl_ptr, label);
+    /* Keep the load factor under 1/2 */
+    if (tbl_ptr->count * 2 > tbl_ptr->slots_cnt)
+        grow_slots(tbl_ptr);
 
     return label;
 }
@@ -175,14 +222,13 @@ void add_external_variable(LabelsTable *tbl_ptr, char *label_name){
 }
 
 void add_data_offset(LabelsTable *tbl_ptr, int offset){
-    /* Iterate over all the nodes and add an offset to the data ones */
-    while (tbl_ptr){
+    int i;
 
-        /* If the node is a data one, add <offset> to its value */
-        if (tbl_ptr->label->is_code == 0)
-            tbl_ptr->label->value += offset;
+    /* Iterate over all the labels and add an offset to the data ones */
+    for (i = 0; i < tbl_ptr->count; i++){
 
-        /* Move to the next node */
-        tbl_ptr = tbl_ptr->next;
+        /* If the label is a data one, add <offset> to its value */
+        if (tbl_ptr->labels[i].is_code == 0)
+            tbl_ptr->labels[i].value += offset;
     }
 }
@@ -8,16 +8,18 @@
 
 /*
  * Represent a Label
+ * Labels are small fixed-size records stored next to each other in the labels table,
+ * their names are kept apart in the names pool of the table
  *
  * Attributes:
- * label - Name of the label
+ * name - Position of the name of the label in the names pool of the table (see get_label_name)
  * value - Address of the label
  * is_code - Flag, false if the label point on data
  * is_entry - Flag, true if the label is an entry
  * is_external - Flag, true if the label is external
  */
 typedef struct Label{
-	char label[80];
+	int name;
 	int value;
 	unsigned int is_code: 1;
 	unsigned int is_entry: 1;
@@ -26,70 +28,57 @@ typedef struct Label{
 
 /*
  * Represent a Labels Table that map the labels
- * Based on the linked list pattern
- * Each node contain a label and a pointer to the next node
+ * Based on an open addressing hash table (linear probing) indexing
+ * an array that keeps the labels in insertion order
  *
  * Attributes:
- * label - Pointer to the label
- * next - Pointer to the next node
+ * labels - Labels, in the order they were added
+ * count - Number of labels in the table
+ * capacity - Number of allocated cells in <labels>
+ * slots - Hash index, each slot hold (position in <labels> + 1) or 0 if empty
+ * slots_cnt - Number of slots (always a power of 2)
+ * names - Pool where the names of the labels are interned, one after the other (null terminated)
+ * names_len - Number of characters used in <names>
+ * names_size - Number of allocated characters in <names>
  */
 typedef struct LabelsTable{
-	Label *label;
-	struct LabelsTable *next;
+	Label *labels;
+	int count;
+	int capacity;
+	int *slots;
+	int slots_cnt;
+	char *names;
+	int names_len;
+	int names_size;
 } LabelsTable;
 
 /*
- * Check if a line contain a label
- *
- * Args:
- * line_ptr - Line to parse
+ * Create an empty labels table
  *
  * Return:
- * True if a string contains a label
+ * Pointer to the new table
  */
-bool contain_label(char *line_ptr);
+LabelsTable *create_labels_table();
 
 /*
- * Parse the label in a line
+ * Free a labels table, its labels and its names pool
  *
  * Args:
- * line - The line to parse
- *
- * Return:
- * The label in a line
- */
-char *get_label(char *line);
-
-/*
- * Parse the label needed by an .entry line
- *
- * Args:
- * line_ptr - Line to parse
- *
- * Return:
- * The label wanted by the entry
+ * tbl_ptr - Table to free
  */
-char *get_entry_label(char *line_ptr);
+void free_labels_table(LabelsTable *tbl_ptr);
 
 /*
- * Skip the label in a string
+ * Return the name of a label
  *
  * Args:
- * line - Line to parse
+ * tbl_ptr - Table holding the label
+ * label - The label
  *
  * Return:
- * The line from after the label
+ * The name of the label (in the names pool, it moves when a label is added)
  */
-char *trim_label(char *line);
-
-/*
- * Add a label to the labels table
- *
- * Args:
- * tbl_ptr - Pointer to the table that maps the labels
- * label - Label to add
- */
-void add_label_to_table(LabelsTable *tbl_ptr, Label *label);
+char *get_label_name(LabelsTable *tbl_ptr, Label *label);
 
 /*
  * Retrieve a label by its name
@@ -100,6 +89,7 @@ void add_label_to_table(LabelsTable *tbl_ptr, Label *label);
  *
  * Return:
  * The label with the given name or null if it doesn't exist
+ * (it moves when a label is added)
  */
 Label *get_label_by_name(LabelsTable *tbl_ptr, char *name);
 
@@ -109,9 +99,12 @@ Label *get_label_by_name(LabelsTable *tbl_ptr, char *name);
  * Args:
  * tbl_ptr - Pointer to the table that maps the labels
  * name - Name of the label to find
- * frame_no -
+ * line_no - Number of the source line using the label (for the messages)
+ *
+ * Return:
+ * The address of the label, 0 for an external label (an error is raised if the label doesn't exist)
  */
-int get_label_addr(LabelsTable *tbl_ptr, char *name);
+int get_label_addr(LabelsTable *tbl_ptr, char *name, int line_no);
 
 /*
  * Mark a label as an entry (given its name)
@@ -119,11 +112,13 @@ int get_label_addr(LabelsTable *tbl_ptr, char *name);
  * Args:
  * tbl_ptr - Table mapping the labels
  * name - Name of the label to mark as entry
+ * line_no - Number of the .entry line (for the messages)
  */
-void mark_label_as_entry(LabelsTable *tbl_ptr, char *name);
+void mark_label_as_entry(LabelsTable *tbl_ptr, char *name, int line_no);
 
 /*
  * Create a label and add it to the table
+ * An error is raised if a label with the same name already exists
  *
  * Args:
  * tbl_ptr - Pointer to the table mapping the labels
@@ -132,6 +127,9 @@ void mark_label_as_entry(LabelsTable *tbl_ptr, char *name);
  * is_code - See is_code flag in Label
  * is_entry - See is_entry flag in Label
  * is_external - See is_external flag in Label
+ *
+ * Return:
+ * The new label (it moves when another label is added)
  */
 Label *create_label(LabelsTable *tbl_ptr, int addr, char *name, int is_code, int is_entry, int is_external);
 
@@ -0,0 +1,285 @@
+/*
+ * Lexer of the source lines
+ * A line is read character by character through a cursor, each character is looked at once:
+ * the label, the mnemonic and the operands are written to the pool as they are read.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "errors.h"
+#include "globals.h"
+#include "instructions.h"
+#include "labels.h"
+#include "lexer.h"
+#include "scanner.h"
+
+#define TOKENS_INIT_CAPACITY 64
+#define QUOTE_CHAR '"'
+#define COMMA_CHAR ','
+
+/*
+ * Position of the lexer in a line
+ *
+ * Attributes:
+ * pos - Next character to read
+ * end - End of the line
+ * raw_len - Number of characters read, consecutive whitespaces counted once
+ * in_space - True if the last character read is a whitespace
+ */
+typedef struct Cursor{
+	char *pos;
+	char *end;
+	int raw_len;
+	bool in_space;
+} Cursor;
+
+/*
+ * Read the next character of a line
+ */
+static char next_char(Cursor *c){
+    char ch;
+
+    ch = *c->pos++;
+    if (isspace((unsigned char) ch)){
+        /* A sequence of whitespaces counts as one character */
+        if (!c->in_space)
+            c->raw_len++;
+        c->in_space = true;
+    }
+    else{
+        c->raw_len++;
+        c->in_space = false;
+    }
+    return ch;
+}
+
+/*
+ * Skip the whitespaces at the position of a cursor
+ */
+static void skip_spaces(Cursor *c){
+    while (c->pos < c->end && isspace((unsigned char) *c->pos))
+        next_char(c);
+}
+
+/*
+ * Append a token to the tokens of a lexer, growing them if needed
+ */
+static Token *add_token(Lexer *lx){
+    Token *new_tokens;
+
+    if (lx->tokens_cnt == lx->tokens_cap){
+        lx->tokens_cap = lx->tokens_cap ? 2 * lx->tokens_cap : TOKENS_INIT_CAPACITY;
+        new_tokens = (Token *) realloc(lx->tokens, lx->tokens_cap * sizeof(Token));
+        if (new_tokens == NULL)
+            raise_error("Internal error: cannot read the source file.");
+        lx->tokens = new_tokens;
+    }
+
+    return &lx->tokens[lx->tokens_cnt++];
+}
+
+/*
+ * Lex a word: everything up to a whitespace, a comma, a quote or (if asked) a colon
+ *
+ * Return:
+ * The word, written in the pool
+ */
+static char *lex_word(Lexer *lx, Cursor *c, bool stop_at_colon){
+    char *word;
+    char ch;
+
+    word = lx->pool;
+    while (c->pos < c->end){
+        ch = *c->pos;
+        if (isspace((unsigned char) ch) || ch == COMMA_CHAR || ch == QUOTE_CHAR || (stop_at_colon && ch == LABEL_CHAR))
+            break;
+        *lx->pool++ = next_char(c);
+    }
+    *lx->pool++ = '\0';
+    return word;
+}
+
+/*
+ * Lex an operand: a string up to its closing quote, or anything else up to the next comma (or colon, if asked)
+ * The characters after the closing quote of a string are dropped
+ */
+static void lex_operand(Lexer *lx, Cursor *c, bool stop_at_colon){
+    Token *tok;
+    char ch;
+
+    tok = add_token(lx);
+    tok->text = lx->pool;
+    tok->value = 0;
+
+    if (*c->pos == QUOTE_CHAR){
+        tok->kind = STRING_TOKEN;
+        next_char(c);
+        while (c->pos < c->end && *c->pos != QUOTE_CHAR)
+            *lx->pool++ = next_char(c);
+        tok->len = lx->pool - tok->text;
+        *lx->pool++ = '\0';
+
+        while (c->pos < c->end && *c->pos != COMMA_CHAR)
+            next_char(c);
+    }
+    else{
+        /* The whitespaces inside an operand are dropped */
+        while (c->pos < c->end && *c->pos != COMMA_CHAR && !(stop_at_colon && *c->pos == LABEL_CHAR)){
+            ch = next_char(c);
+            if (!isspace((unsigned char) ch))
+                *lx->pool++ = ch;
+        }
+        tok->len = lx->pool - tok->text;
+        *lx->pool++ = '\0';
+
+        if (*tok->text == '$'){
+            tok->kind = REGISTER_TOKEN;
+            tok->value = atoi(tok->text + 1);
+        }
+        else if (isdigit((unsigned char) *tok->text) || *tok->text == '-' || *tok->text == '+'){
+            tok->kind = IMMEDIATE_TOKEN;
+            tok->value = atoi(tok->text);
+        }
+        else
+            tok->kind = LABEL_TOKEN;
+    }
+}
+
+/*
+ * Find the kind of a line from its mnemonic
+ */
+static void classify_line(SourceLine *line, char *word){
+    size_t len;
+
+    len = strlen(word);
+    if (len > MNEMONIC_MAX_SIZE - 1)
+        len = MNEMONIC_MAX_SIZE - 1;
+    memcpy(line->mnemonic, word, len);
+    line->mnemonic[len] = '\0';
+
+    line->instr = NULL;
+    line->directive = *word == '.' ? lookup_directive(word) : NULL;
+    if (line->directive == NULL){
+        line->kind = CODE_LINE;
+        line->instr = lookup_instruction(word);
+    }
+    else if (line->directive->kind == DATA_DIRECTIVE)
+        line->kind = DATA_LINE;
+    else if (line->directive->kind == ENTRY_DIRECTIVE)
+        line->kind = ENTRY_LINE;
+    else
+        line->kind = EXTERNAL_LINE;
+}
+
+/*
+ * Lex the statement of a line (what follows its label): the mnemonic, then the operands
+ * Until the line has a label, a colon stops the statement (what was read was the label)
+ *
+ * Return:
+ * Position of the colon that stopped the statement, NULL if the end of the line was reached
+ */
+static char *lex_statement(Lexer *lx, Cursor *c, SourceLine *line){
+    bool no_label, after_comma;
+
+    /* The scanner tells if there is a colon to look for */
+    no_label = line->label == NULL && (line->flags & LINE_COLON) != 0;
+
+    skip_spaces(c);
+    classify_line(line, lex_word(lx, c, no_label));
+
+    after_comma = false;
+    for (;;){
+        skip_spaces(c);
+        if (c->pos == c->end)
+            return NULL;
+
+        if (no_label && *c->pos == LABEL_CHAR)
+            return c->pos;
+
+        if (*c->pos == COMMA_CHAR){
+            if (after_comma)
+                line->double_comma = true;
+            after_comma = true;
+            next_char(c);
+            continue;
+        }
+
+        lex_operand(lx, c, no_label);
+        after_comma = false;
+    }
+}
+
+/*
+ * Copy a label as written before its colon, keeping only the first whitespace (as a space) of every sequence
+ *
+ * Return:
+ * Pointer to the free memory after the label
+ */
+static char *copy_label(char *dst, char *start, char *colon){
+    bool space_seen;
+
+    space_seen = false;
+    for (; start < colon; start++){
+        if (isspace((unsigned char) *start)){
+            if (!space_seen)
+                *dst++ = WHITESPACE;
+            space_seen = true;
+        }
+        else{
+            *dst++ = *start;
+            space_seen = false;
+        }
+    }
+    *dst++ = '\0';
+    return dst;
+}
+
+void init_lexer(Lexer *lx, char *pool){
+    lx->pool = pool;
+    lx->tokens = NULL;
+    lx->tokens_cnt = lx->tokens_cap = 0;
+}
+
+void lex_line(Lexer *lx, SourceLine *line){
+    Cursor c;
+    char *body, *colon, *line_pool;
+    int first_token;
+
+    c.pos = line->start;
+    c.end = line->start + line->len;
+    c.raw_len = 0;
+    c.in_space = false;
+
+    line->kind = IRRELEVANT_LINE;
+
+    /* Blank and commented out lines are irrelevant, the scanner found them already */
+    if (line->flags & LINE_BLANK)
+        return;
+
+    skip_spaces(&c);
+
+    body = c.pos;
+    line_pool = lx->pool;
+    first_token = lx->tokens_cnt;
+
+    colon = lex_statement(lx, &c, line);
+    if (colon != NULL){
+        /* What was read is the label, drop its tokens */
+        lx->tokens_cnt = first_token;
+        line->double_comma = false;
+
+        /* Most of the time the label is the first word, which is already in the pool */
+        line->label = line_pool;
+        if (strlen(line_pool) == (size_t) (colon - body))
+            lx->pool = line_pool + (colon - body) + 1;
+        else
+            lx->pool = copy_label(line_pool, body, colon);
+
+        next_char(&c);
+        lex_statement(lx, &c, line);
+    }
+
+    line->operands_cnt = lx->tokens_cnt - first_token;
+    line->raw_len = c.raw_len;
+    line->open_quote = (line->flags & LINE_OPEN_QUOTE) != 0;
+}
@@ -0,0 +1,50 @@
+/*
+ * Lexer of the source lines
+ * Each line is walked once: its label, its command or directive and its typed operands are cut out
+ * in the same scan, then the checker and both passes only look at the tokens.
+ * The lexer keeps no state of its own (everything is in the Lexer given by the caller), so several
+ * files can be lexed at the same time.
+ */
+#ifndef LEXER_H
+#define LEXER_H
+
+#include "source.h"
+
+/*
+ * State of the lexer over a source file
+ *
+ * Attributes:
+ * pool - Free memory where the strings of the lines are written
+ * tokens - Operands of the lexed lines, in line order (reallocated as it grows)
+ * tokens_cnt - Number of tokens
+ * tokens_cap - Number of allocated tokens
+ */
+typedef struct Lexer{
+	char *pool;
+	Token *tokens;
+	int tokens_cnt;
+	int tokens_cap;
+} Lexer;
+
+/*
+ * Initialize a lexer
+ *
+ * Args:
+ * lx - The lexer
+ * pool - Memory for the strings of the lines, at least 2 * (<size of the file> + 2 * <number of lines>) characters
+ */
+void init_lexer(Lexer *lx, char *pool);
+
+/*
+ * Lex a line: set its kind, label, mnemonic, command or directive, operands and flags
+ * The operands are appended to the tokens of the lexer, and <line->operands> is left NULL
+ * (the tokens may still move, point the lines to them once the whole file is lexed)
+ * An error is raised if there is no memory for the tokens
+ *
+ * Args:
+ * lx - The lexer
+ * line - The line to lex, its <start>, <len>, <line_no> and <flags> members must already be set (see scanner.h)
+ */
+void lex_line(Lexer *lx, SourceLine *line);
+
+#endif
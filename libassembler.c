@@ -0,0 +1,171 @@
+/*
+ * Embeddable assembler (libassembler.a)
+ * Each call runs in its own context: errors only stop the call, messages go to its log,
+ * and the second pass keeps the outputs in the result instead of writing files
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "errors.h"
+#include "first_pass.h"
+#include "second_pass.h"
+#include "source.h"
+#include "context.h"
+#include "libassembler.h"
+
+/* Name of the source in the context (never used as a file name) */
+#define BUFFER_SOURCE_NAME "<buffer>"
+
+/* Messages about a line start with this prefix, followed by the number of the line */
+#define LINE_MESSAGE_PREFIX "[x] Error on line "
+
+/*
+ * Parse, check and assemble the source of a context
+ */
+static void assemble_in_memory(Context *ctx){
+    char *content;
+
+    /* The source file takes the content over */
+    content = ctx->content;
+    ctx->content = NULL;
+    ctx->src = read_source_buffer(ctx->fname, content, ctx->content_size);
+
+    ctx->is_valid = first_pass(ctx->src);
+    if (!ctx->is_valid)
+        return;
+
+    second_pass(ctx->src, ctx->labels, ctx->ic_size, ctx->dc_size);
+}
+
+/*
+ * Split the log of a context into diagnostics, one per line
+ * The diagnostics are dropped if there is no memory for them
+ */
+static void collect_diagnostics(Context *ctx, AsmResult *result){
+    AsmDiagnostic *diag;
+    char *line, *eol, *end;
+    int cnt;
+
+    if (ctx->log_len == 0)
+        return;
+
+    end = ctx->log + ctx->log_len;
+    for (cnt = 0, line = ctx->log; line < end; cnt++){
+        eol = (char *) memchr(line, '\n', end - line);
+        line = eol == NULL ? end : eol + 1;
+    }
+
+    result->diagnostics = (AsmDiagnostic *) calloc(cnt, sizeof(AsmDiagnostic));
+    if (result->diagnostics == NULL)
+        return;
+
+    for (line = ctx->log; line < end; line = eol + 1){
+        eol = (char *) memchr(line, '\n', end - line);
+        if (eol == NULL)
+            eol = end;
+
+        diag = &result->diagnostics[result->diagnostics_cnt];
+        diag->message = (char *) malloc(eol - line + 1);
+        if (diag->message == NULL)
+            return;
+        memcpy(diag->message, line, eol - line);
+        diag->message[eol - line] = '\0';
+
+        if (strncmp(line, LINE_MESSAGE_PREFIX, strlen(LINE_MESSAGE_PREFIX)) == 0)
+            diag->line_no = atoi(line + strlen(LINE_MESSAGE_PREFIX));
+
+        result->diagnostics_cnt++;
+    }
+}
+
+/*
+ * Free the images and tables of a result, keeping its status and diagnostics
+ */
+static void free_outputs(AsmResult *result){
+    int i;
+
+    for (i = 0; i < result->entries_cnt; i++)
+        free(result->entries[i].name);
+    for (i = 0; i < result->externals_cnt; i++)
+        free(result->externals[i].name);
+
+    free(result->code);
+    free(result->data);
+    free(result->entries);
+    free(result->externals);
+    free(result->object_text);
+
+    result->code = result->data = NULL;
+    result->code_size = result->data_size = 0;
+    result->entries = result->externals = NULL;
+    result->entries_cnt = result->externals_cnt = 0;
+    result->object_text = NULL;
+    result->object_text_len = 0;
+}
+
+AsmStatus assemble_buffer(const char *src, size_t len, const AsmOptions *options, AsmResult *result){
+    Context *ctx;
+    char *content;
+
+    memset(result, 0, sizeof(AsmResult));
+    result->status = ASM_FAILED;
+
+    ctx = create_context(BUFFER_SOURCE_NAME);
+    content = (char *) malloc(len + 1);
+    if (ctx == NULL || content == NULL){
+        free_context(ctx);
+        free(content);
+        return result->status;
+    }
+
+    memcpy(content, src, len);
+    ctx->content = content;
+    ctx->content_size = len;
+    ctx->result = result;
+    ctx->object_text = options != NULL && options->object_text;
+    ctx->group_externals = options != NULL && options->group_externals;
+
+    run_in_context(ctx, assemble_in_memory);
+
+    result->status = ctx->failed ? ASM_FAILED : !ctx->is_valid ? ASM_INVALID : ASM_OK;
+    if (result->status != ASM_OK)
+        free_outputs(result);
+    collect_diagnostics(ctx, result);
+
+    free_context(ctx);
+    return result->status;
+}
+
+void free_asm_result(AsmResult *result){
+    int i;
+
+    free_outputs(result);
+
+    for (i = 0; i < result->diagnostics_cnt; i++)
+        free(result->diagnostics[i].message);
+    free(result->diagnostics);
+    result->diagnostics = NULL;
+    result->diagnostics_cnt = 0;
+}
+
+void add_asm_symbol(AsmSymbol **symbols, int *cnt, char *name, long address){
+    AsmSymbol *new_symbols;
+    char *copy;
+
+    /* The list doubles each time its count reaches a power of 2 */
+    if ((*cnt & (*cnt - 1)) == 0){
+        new_symbols = (AsmSymbol *) realloc(*symbols, (*cnt ? 2 * *cnt : 1) * sizeof(AsmSymbol));
+        if (new_symbols == NULL)
+            raise_error("Internal error: out of memory.");
+        *symbols = new_symbols;
+    }
+
+    copy = (char *) malloc(strlen(name) + 1);
+    if (copy == NULL)
+        raise_error("Internal error: out of memory.");
+    strcpy(copy, name);
+
+    (*symbols)[*cnt].name = copy;
+    (*symbols)[*cnt].address = address;
+    (*cnt)++;
+}
@@ -0,0 +1,131 @@
+/*
+ * Embeddable assembler (libassembler.a)
+ * Assemble a source held in memory and get the outputs back in memory:
+ * no file is read or written, nothing is printed, the process never exits and
+ * nothing is shared between calls (several threads can assemble at the same time)
+ *
+ * Link with: libassembler.a -lpthread
+ */
+#ifndef LIBASSEMBLER_H
+#define LIBASSEMBLER_H
+
+#include <stddef.h>
+
+/* Address of the first instruction, the data follows the code */
+#define ASM_CODE_ADDRESS 100
+
+/*
+ * Status of an assembling
+ */
+typedef enum {
+	ASM_OK,
+	ASM_INVALID, /* The checker found errors in the source */
+	ASM_FAILED /* An error stopped the assembling (undefined label, value out of range, out of memory...) */
+} AsmStatus;
+
+/*
+ * Options of an assembling
+ *
+ * Attributes:
+ * object_text - Non zero to render the object file (.ob format) in the result too
+ * group_externals - Non zero to group the external references by label (in the order of the .extern lines),
+ *                   the references of a label staying in source order
+ */
+typedef struct AsmOptions{
+	int object_text;
+	int group_externals;
+} AsmOptions;
+
+/*
+ * Represent a symbol of the outputs
+ *
+ * Attributes:
+ * name - Name of the label
+ * address - Address of the label for an entry, address of the instruction using the label for an external reference
+ */
+typedef struct AsmSymbol{
+	char *name;
+	long address;
+} AsmSymbol;
+
+/*
+ * Represent a diagnostic message
+ *
+ * Attributes:
+ * line_no - Number of the line of the source (starting from 1), 0 if the message is not about a line
+ * message - The message, as the assembler prints it ("[x] Error on line ...")
+ */
+typedef struct AsmDiagnostic{
+	int line_no;
+	char *message;
+} AsmDiagnostic;
+
+/*
+ * Outputs of an assembling, the images and tables are only set when the status is ASM_OK
+ *
+ * Attributes:
+ * status - Status of the assembling
+ * code - Encoded instructions, 4 little endian bytes each, loaded at ASM_CODE_ADDRESS
+ * code_size - Number of bytes in <code>
+ * data - Data image, loaded right after the code
+ * data_size - Number of bytes in <data>
+ * entries - Entry labels, in definition order
+ * entries_cnt - Number of entries
+ * externals - External references, one per instruction using an external label, in source order (see group_externals)
+ * externals_cnt - Number of external references
+ * diagnostics - Messages of the assembling, in the order they were emitted
+ * diagnostics_cnt - Number of diagnostics
+ * object_text - The object file (.ob format), NULL unless asked for in the options
+ * object_text_len - Length of <object_text>
+ */
+typedef struct AsmResult{
+	AsmStatus status;
+	unsigned char *code;
+	size_t code_size;
+	unsigned char *data;
+	size_t data_size;
+	AsmSymbol *entries;
+	int entries_cnt;
+	AsmSymbol *externals;
+	int externals_cnt;
+	AsmDiagnostic *diagnostics;
+	int diagnostics_cnt;
+	char *object_text;
+	size_t object_text_len;
+} AsmResult;
+
+/*
+ * Assemble a source held in memory
+ *
+ * Args:
+ * src - The source (it doesn't need to be null terminated)
+ * len - Length of <src>
+ * options - Options of the assembling, NULL for the defaults
+ * result - Where the outputs are written, free them with free_asm_result
+ *
+ * Return:
+ * The status of the assembling (also in <result>)
+ */
+AsmStatus assemble_buffer(const char *src, size_t len, const AsmOptions *options, AsmResult *result);
+
+/*
+ * Free the outputs of an assembling (the result itself is not freed)
+ *
+ * Args:
+ * result - The result filled by assemble_buffer
+ */
+void free_asm_result(AsmResult *result);
+
+/*
+ * Append a symbol to a list of symbols of a result (used while assembling)
+ * An error is raised if there is no memory
+ *
+ * Args:
+ * symbols - The list, reallocated as it grows
+ * cnt - Number of symbols in the list, incremented
+ * name - Name of the symbol (copied)
+ * address - Address of the symbol
+ */
+void add_asm_symbol(AsmSymbol **symbols, int *cnt, char *name, long address);
+
+#endif
@@ -1,51 +1,462 @@
 /*
  * Assemble assembler code (.as file)
- * The assembling is done in two passes:
- * The first pass mostly calculate the address of each label and store them into a table.
+ * Each file is read and parsed once.
+ * The first pass checks every line for errors and calculate the address of each label (stored into a table), in one scan.
  * The second pass encode every line and dump it to a file.
  *
- * Temporary files are used during the second pass, and will be automatically deleted
- * at the end of the assembling.
+ * With -j N, the files are checked and assembled on N worker threads (biggest files first).
+ * The messages of every file are kept aside and printed in the order of the arguments,
+ * so the output doesn't depend on the number of workers.
+ *
+ * With --stats (or --stats=json), the time spent in each phase and counters of what was read
+ * and written are printed on the standard error, for every file and in total.
+ *
+ * With --binary, a binary object file (.bin, see binary.h) is written next to the text outputs.
+ *
+ * With --group-externals, the external references are grouped by label instead of following the source.
+ *
+ * With --cache DIR, the outputs of every assembled file are stored in DIR under the hash of the file,
+ * and the files whose hash is already there get their outputs back without being assembled (see cache.h).
+ *
+ * With --server SOCKET, the assembler stays up and assembles the files sent on a Unix socket, and
+ * with --client SOCKET, the files are sent to that server instead of being assembled here (see server.h).
+ *
+ * With --pipe, the source is read from the standard input and the outputs are written to the standard
+ * output (or to the file descriptors given by --ent-fd and --ext-fd), no file is touched (see pipeline.h).
+ *
+ * The outputs of the second pass are built in memory and each output file is written at once.
  */
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
 #include "globals.h"
 #include "first_pass.h"
+#include "second_pass.h"
 #include "errors.h"
+#include "source.h"
+#include "context.h"
+#include "jobs.h"
+#include "utils.h"
+#include "stats.h"
+#include "cache.h"
+#include "server.h"
+#include "pipeline.h"
+
+#define USAGE "usage: assembler [-j N] [--stats[=json]] [--binary] [--group-externals] [--stream] [--cache DIR] file1.as file2.as...\n" \
+              "       assembler [-j N] --server SOCKET\n" \
+              "       assembler --client SOCKET [--binary] [--outdir DIR] [--inline] file1.as file2.as...\n" \
+              "       assembler --client SOCKET --shutdown\n" \
+              "       assembler --pipe [--ent-fd N] [--ext-fd N] [--group-externals] < file.as > file.ob"
+
+/*
+ * Format of the statistics
+ */
+typedef enum {
+	NO_STATS,
+	TEXT_STATS,
+	JSON_STATS
+} StatsFormat;
+
+static StatsFormat stats_format = NO_STATS;
+static bool binary_output = false; /* Write binary object files too (--binary) */
+static bool group_externals = false; /* Group the external references by label (--group-externals) */
+static bool streaming = false; /* Stream the files through a window of lines (--stream) */
+static char *cache_dir = NULL; /* Build cache directory (--cache) */
+static char *server_socket = NULL; /* Socket to serve on (--server) */
+static char *client_socket = NULL; /* Socket of the server the files are sent to (--client) */
+static char *outdir = NULL; /* Directory of the outputs in client mode (--outdir) */
+static bool inline_source = false; /* Send the content of the files to the server (--inline) */
+static bool shutdown_server = false; /* Stop the server (--shutdown) */
+static bool pipe_mode = false; /* Assemble the standard input to the standard output (--pipe) */
+static int ent_fd = -1; /* File descriptor of the entries in pipeline mode (--ent-fd) */
+static int ext_fd = -1; /* File descriptor of the externals in pipeline mode (--ext-fd) */
+static double start_wall; /* Wall clock at the start of the program */
+
+/*
+ * Get the value of an option written either --name=VALUE or --name VALUE
+ *
+ * Args:
+ * argc - Number of arguments
+ * argv - The arguments
+ * i - Index of the option, moved after the option and its value
+ * name - Name of the option
+ *
+ * Return:
+ * The value, NULL if the option is not followed by a value (the program exits)
+ */
+static char *get_option_value(int argc, char *argv[], int *i, char *name){
+    char *arg;
+    size_t len;
+
+    arg = argv[*i];
+    len = strlen(name);
+
+    if (arg[len] == '='){
+        (*i)++;
+        return arg + len + 1;
+    }
+    if (arg[len] == '\0' && *i + 1 < argc){
+        *i += 2;
+        return argv[*i - 1];
+    }
+
+    printf("Bad %s option, " USAGE "\n", name);
+    exit(1);
+    return NULL;
+}
+
+/*
+ * Restore the outputs of a file from the build cache
+ *
+ * Return:
+ * True if the outputs were restored, the file doesn't need to be assembled
+ */
+static bool restore_cached_outputs(Context *ctx){
+    char options[64]; /* The options that change the outputs */
+
+    options[0] = '\0';
+    if (ctx->binary_output)
+        strcat(options, "--binary");
+    if (ctx->group_externals)
+        strcat(options, options[0] != '\0' ? " --group-externals" : "--group-externals");
+
+    if (!get_cache_key(ctx->fname, options, ctx->cache_key)){
+        ctx->cache_key[0] = '\0';
+        return false;
+    }
+
+    if (!restore_from_cache(ctx->cache_dir, ctx->cache_key, get_basename(ctx->fname), ctx->binary_output))
+        return false;
+
+    report("[v] Outputs restored from the cache\n");
+    return true;
+}
+
+/*
+ * Read a file, check it for errors and map its labels (first pass)
+ * With a build cache, a file whose outputs are cached is not even read
+ */
+static void check_source(Context *ctx){
+    if (ctx->cache_dir != NULL && restore_cached_outputs(ctx)){
+        ctx->cached = true;
+        return;
+    }
+
+    /* A streamed file is read by the passes themselves, a window at a time */
+    if (ctx->streaming){
+        ctx->is_valid = first_pass_stream(ctx->fname);
+        return;
+    }
+
+    start_phase(&ctx->stats, READ_PHASE);
+    ctx->src = read_source_file(ctx->fname);
+    ctx->stats.lines = ctx->src->lines_cnt;
+    end_phase(&ctx->stats, READ_PHASE);
+
+    ctx->is_valid = first_pass(ctx->src);
+}
+
+/*
+ * Assemble a checked file (second pass)
+ */
+static void assemble_source(Context *ctx){
+    if (ctx->cached)
+        return;
+
+    if (ctx->streaming)
+        second_pass_stream(ctx->fname, ctx->labels, ctx->ic_size, ctx->dc_size);
+    else{
+        second_pass(ctx->src, ctx->labels, ctx->ic_size, ctx->dc_size);
+        free_source_file(ctx->src);
+        ctx->src = NULL;
+    }
+
+    if (ctx->cache_dir != NULL && ctx->cache_key[0] != '\0')
+        store_in_cache(ctx->cache_dir, ctx->cache_key, get_basename(ctx->fname), ctx->binary_output);
+}
+
+static void check_job(void *ctx){
+    run_in_context((Context *) ctx, check_source);
+}
+
+static void assemble_job(void *ctx){
+    run_in_context((Context *) ctx, assemble_source);
+}
+
+/*
+ * Order contexts by decreasing file size
+ */
+static int cmp_size_desc(const void *a, const void *b){
+    long size_a = (*(Context **) a)->size;
+    long size_b = (*(Context **) b)->size;
+
+    return size_a < size_b ? 1 : size_a > size_b ? -1 : 0;
+}
+
+/*
+ * Run one phase (checking or assembling) on every file and print the messages of each file
+ * Every file goes through the phase, even after a file failed
+ *
+ * Args:
+ * ctxs - Contexts of the files, in the order of the arguments
+ * cnt - Number of files
+ * workers_cnt - Number of worker threads
+ * job - The job to run on each context
+ * title - Title printed before the messages of each file
+ *
+ * Return:
+ * False if an error stopped the phase for any file
+ */
+static bool run_phase(Context **ctxs, int cnt, int workers_cnt, void (*job)(void *), char *title){
+    Context **jobs;
+    int i;
+    bool ok;
+
+    ok = true;
+
+    /* Run the files on the workers, biggest files first to finish as early as possible */
+    if (workers_cnt > 1){
+        jobs = (Context **) calloc(cnt, sizeof(Context *));
+        memcpy(jobs, ctxs, cnt * sizeof(Context *));
+        qsort(jobs, cnt, sizeof(Context *), cmp_size_desc);
+        run_jobs(job, (void **) jobs, cnt, workers_cnt);
+        free(jobs);
+    }
+
+    /*
+     * Print every file's messages in order
+     * A failing file doesn't stop the other ones (not even in sequential mode), so that the
+     * outputs and the messages are the same whatever the number of workers
+     */
+    for (i = 0; i < cnt; i++){
+        if (workers_cnt <= 1)
+            job(ctxs[i]);
+
+        printf(title, ctxs[i]->fname);
+        flush_log(ctxs[i]);
+
+        if (ctxs[i]->failed)
+            ok = false;
+    }
+
+    return ok;
+}
+
+/*
+ * Print the statistics of every file and their total on the standard error
+ *
+ * Args:
+ * ctxs - Contexts of the files
+ * cnt - Number of files
+ */
+static void print_all_stats(Context **ctxs, int cnt){
+    Stats total;
+    int i;
+
+    /* The messages of the files are printed first */
+    fflush(stdout);
+
+    memset(&total, 0, sizeof(Stats));
+    for (i = 0; i < cnt; i++)
+        add_stats(&total, &ctxs[i]->stats);
+
+    if (stats_format == TEXT_STATS){
+        for (i = 0; i < cnt; i++)
+            print_stats(stderr, ctxs[i]->fname, &ctxs[i]->stats);
+        print_stats(stderr, "total", &total);
+        fprintf(stderr, "    process: wall %.6f s, cpu %.6f s\n", get_wall_time() - start_wall, get_process_cpu_time());
+        return;
+    }
+
+    fprintf(stderr, "{\"files\": [");
+    for (i = 0; i < cnt; i++){
+        fprintf(stderr, i > 0 ? ",\n    " : "\n    ");
+        print_stats_json(stderr, ctxs[i]->fname, ctxs[i]->failed || !ctxs[i]->is_valid, &ctxs[i]->stats);
+    }
+    fprintf(stderr, "\n],\n\"total\": ");
+    print_stats_json(stderr, NULL, false, &total);
+    fprintf(stderr, ",\n\"wall\": %.6f, \"cpu\": %.6f}\n", get_wall_time() - start_wall, get_process_cpu_time());
+}
+
+/*
+ * Print the statistics if they were asked for, then exit
+ *
+ * Args:
+ * ctxs - Contexts of the files
+ * cnt - Number of files
+ * code - Exit code
+ */
+static void finish(Context **ctxs, int cnt, int code){
+    if (stats_format != NO_STATS)
+        print_all_stats(ctxs, cnt);
+    exit(code);
+}
 
 int main(int argc, char* argv[])
 {
 	int i;
     bool is_valid;
+    int first_file; /* Index of the first file in argv */
+    int files_cnt; /* Number of files to assemble */
+    int workers_cnt; /* Number of worker threads */
+    Context **ctxs; /* Context of each file */
 
     is_valid = true;
+    workers_cnt = 1;
+    first_file = 1;
+
+    start_wall = get_wall_time();
+
+    /* Parse options */
+    while (first_file < argc && argv[first_file][0] == '-'){
+        if (starts_with(argv[first_file], "-j")){
+            /* Either -jN or -j N */
+            if (argv[first_file][2] != '\0')
+                workers_cnt = atoi(argv[first_file++] + 2);
+            else{
+                workers_cnt = first_file + 1 < argc ? atoi(argv[first_file + 1]) : 0;
+                first_file += 2;
+            }
+
+            if (workers_cnt < 1){
+                printf("Bad number of workers, " USAGE "\n");
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[first_file], "--stats") == 0){
+            stats_format = TEXT_STATS;
+            first_file++;
+        }
+        else if (strcmp(argv[first_file], "--stats=json") == 0){
+            stats_format = JSON_STATS;
+            first_file++;
+        }
+        else if (strcmp(argv[first_file], "--binary") == 0){
+            binary_output = true;
+            first_file++;
+        }
+        else if (strcmp(argv[first_file], "--group-externals") == 0){
+            group_externals = true;
+            first_file++;
+        }
+        else if (strcmp(argv[first_file], "--stream") == 0){
+            streaming = true;
+            first_file++;
+        }
+        else if (starts_with(argv[first_file], "--cache"))
+            cache_dir = get_option_value(argc, argv, &first_file, "--cache");
+        else if (starts_with(argv[first_file], "--server"))
+            server_socket = get_option_value(argc, argv, &first_file, "--server");
+        else if (starts_with(argv[first_file], "--client"))
+            client_socket = get_option_value(argc, argv, &first_file, "--client");
+        else if (starts_with(argv[first_file], "--outdir"))
+            outdir = get_option_value(argc, argv, &first_file, "--outdir");
+        else if (strcmp(argv[first_file], "--inline") == 0){
+            inline_source = true;
+            first_file++;
+        }
+        else if (strcmp(argv[first_file], "--shutdown") == 0){
+            shutdown_server = true;
+            first_file++;
+        }
+        else if (strcmp(argv[first_file], "--pipe") == 0){
+            pipe_mode = true;
+            first_file++;
+        }
+        else if (starts_with(argv[first_file], "--ent-fd"))
+            ent_fd = atoi(get_option_value(argc, argv, &first_file, "--ent-fd"));
+        else if (starts_with(argv[first_file], "--ext-fd"))
+            ext_fd = atoi(get_option_value(argc, argv, &first_file, "--ext-fd"));
+        else{
+            printf("Unknown option %s, " USAGE "\n", argv[first_file]);
+            exit(1);
+        }
+    }
+
+    files_cnt = argc - first_file;
+
+    /* A streamed file never has its whole code in memory, the binary object file needs it */
+    if (streaming && binary_output){
+        printf("--stream cannot be used with --binary, " USAGE "\n");
+        exit(1);
+    }
+
+    /* Server mode - never returns before the server is stopped */
+    if (server_socket != NULL)
+        exit(run_server(server_socket, workers_cnt) ? 0 : 1);
+
+    if (client_socket != NULL && shutdown_server)
+        exit(stop_server(client_socket) ? 0 : 1);
 
-	if (argc <= 1){
-		printf("no file passed\n");
+    /* Pipeline mode - the standard output only holds the outputs, the messages go to the standard error */
+    if (pipe_mode){
+        if (files_cnt > 0){
+            fprintf(stderr, "No file can be passed with --pipe, " USAGE "\n");
+            exit(1);
+        }
+        exit(run_pipeline(ent_fd, ext_fd, group_externals) ? 0 : 1);
+    }
+
+    if (files_cnt <= 0){
+        printf("no file passed\n");
         exit(0);
     }
 
+    /* Client mode - the server assembles the files */
+    if (client_socket != NULL){
+        if (!run_client(client_socket, argv + first_file, files_cnt, outdir, binary_output, inline_source)){
+            printf("Exiting with code 1.\n");
+            exit(1);
+        }
+        printf("[v] Assembling finished without errors.\n");
+        exit(0);
+    }
+
+    ctxs = (Context **) calloc(files_cnt, sizeof(Context *));
+    for (i = 0; i < files_cnt; i++){
+        ctxs[i] = create_context(argv[first_file + i]);
+        if (ctxs[i] == NULL)
+            raise_error("Internal error: cannot create a context.");
+        ctxs[i]->size = get_file_size(ctxs[i]->fname);
+        ctxs[i]->binary_output = binary_output;
+        ctxs[i]->group_externals = group_externals;
+        ctxs[i]->streaming = streaming;
+        ctxs[i]->cache_dir = cache_dir;
+
+        /* The workers left over by the files split the lines of big files */
+        ctxs[i]->line_workers = workers_cnt > files_cnt ? workers_cnt / files_cnt : 1;
+    }
 
     printf("Checking errors.\n");
-    for (i = 1; i < argc; i++){
-        printf("[*] Checking file %s\n", argv[i]);
-        if (!check_file(argv[i]))
-            is_valid = false;
+    if (!run_phase(ctxs, files_cnt, workers_cnt, check_job, "[*] Checking file %s\n")){
+        printf("Exiting with code 1.\n");
+        finish(ctxs, files_cnt, 1);
     }
 
+    for (i = 0; i < files_cnt; i++)
+        if (!ctxs[i]->is_valid)
+            is_valid = false;
+
     if (!is_valid){
         printf("Errors in files, exiting.\n");
-        exit(1);
+        finish(ctxs, files_cnt, 1);
     }
 
     /* Process every file */
-    for (i = 1; i < argc; i++){
-        printf("[*] Processing file %s\n", argv[i]);
-        first_pass(argv[i]);
+    if (!run_phase(ctxs, files_cnt, workers_cnt, assemble_job, "[*] Processing file %s\n")){
+        printf("Exiting with code 1.\n");
+        finish(ctxs, files_cnt, 1);
     }
 
     printf("[v] Assembling finished without errors.\n");
 
+    if (stats_format != NO_STATS)
+        print_all_stats(ctxs, files_cnt);
+
+    for (i = 0; i < files_cnt; i++)
+        free_context(ctxs[i]);
+    free(ctxs);
+
 	return 0;
 }
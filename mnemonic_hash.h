@@ -0,0 +1,26 @@
+/*
+ * Hash function of the mnemonics
+ * Shared by the generator of the instructions table and the lookup in instructions.c
+ */
+#ifndef MNEMONIC_HASH_H
+#define MNEMONIC_HASH_H
+
+/*
+ * Hash a mnemonic (FNV-1a, then multiplied by <seed>)
+ *
+ * Args:
+ * s - The mnemonic
+ * seed - Initial value of the hash
+ *
+ * Return:
+ * The hash of <s>, on 32 bits
+ */
+static unsigned long hash_mnemonic(const char *s, unsigned long seed){
+    unsigned long h = 2166136261UL;
+
+    while (*s)
+        h = ((h ^ (unsigned char) *s++) * 16777619UL) & 0xffffffffUL;
+    return ((h * (2 * seed + 1)) & 0xffffffffUL) >> 16;
+}
+
+#endif
@@ -0,0 +1,163 @@
+/*
+ * Pipeline mode (--pipe)
+ * The source is assembled in memory (see libassembler.h), then each output is written in one go
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "libassembler.h"
+#include "pipeline.h"
+
+#define READ_CHUNK_SIZE 65536
+#define SYMBOL_LINE_EXTRA_SIZE 16 /* Space, address (at least 4 digits) and line break of a symbol line */
+
+/*
+ * Write a whole buffer to a file descriptor
+ *
+ * Return:
+ * False if the buffer cannot be written
+ */
+static bool write_all(int fd, char *buf, size_t size){
+    ssize_t n;
+
+    while (size > 0){
+        n = write(fd, buf, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        buf += n;
+        size -= n;
+    }
+    return true;
+}
+
+/*
+ * Read the whole standard input
+ *
+ * Args:
+ * size - Where the number of read characters is written
+ *
+ * Return:
+ * The content (to free), NULL if it cannot be read
+ */
+static char *read_stdin(size_t *size){
+    char *buf, *new_buf;
+    size_t cap;
+    ssize_t n;
+
+    cap = READ_CHUNK_SIZE;
+    *size = 0;
+    buf = (char *) malloc(cap);
+
+    while (buf != NULL){
+        n = read(STDIN_FILENO, buf + *size, cap - *size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0){
+            free(buf);
+            return NULL;
+        }
+        if (n == 0)
+            break;
+
+        *size += n;
+        if (*size == cap){
+            cap *= 2;
+            new_buf = (char *) realloc(buf, cap);
+            if (new_buf == NULL)
+                free(buf);
+            buf = new_buf;
+        }
+    }
+    return buf;
+}
+
+/*
+ * Write symbols in the format of the .ent and .ext files
+ *
+ * Args:
+ * fd - The file descriptor
+ * tag - Tag line written first, NULL for none
+ * symbols - The symbols
+ * cnt - Number of symbols
+ *
+ * Return:
+ * False if the symbols cannot be written
+ */
+static bool write_symbols(int fd, char *tag, AsmSymbol *symbols, int cnt){
+    char *buf;
+    size_t size, len;
+    int i;
+    bool ok;
+
+    size = tag != NULL ? strlen(tag) + 1 : 1;
+    for (i = 0; i < cnt; i++)
+        size += strlen(symbols[i].name) + SYMBOL_LINE_EXTRA_SIZE;
+
+    buf = (char *) malloc(size);
+    if (buf == NULL)
+        return false;
+
+    len = tag != NULL ? sprintf(buf, "%s", tag) : 0;
+    for (i = 0; i < cnt; i++)
+        len += sprintf(buf + len, "%s %04ld\n", symbols[i].name, symbols[i].address);
+
+    ok = write_all(fd, buf, len);
+    free(buf);
+    return ok;
+}
+
+/*
+ * Check that a file descriptor is open
+ */
+static bool is_open_fd(int fd){
+    return fd < 0 || fcntl(fd, F_GETFD) != -1;
+}
+
+bool run_pipeline(int ent_fd, int ext_fd, bool group_externals){
+    AsmOptions options;
+    AsmResult result;
+    char *src;
+    size_t len;
+    int i;
+    bool ok;
+
+    if (!is_open_fd(ent_fd) || !is_open_fd(ext_fd)){
+        fprintf(stderr, "[x] Bad file descriptor for the entries or the externals\n");
+        return false;
+    }
+
+    src = read_stdin(&len);
+    if (src == NULL){
+        fprintf(stderr, "[x] Cannot read the standard input\n");
+        return false;
+    }
+
+    options.object_text = 1;
+    options.group_externals = group_externals;
+    assemble_buffer(src, len, &options, &result);
+    free(src);
+
+    for (i = 0; i < result.diagnostics_cnt; i++)
+        fprintf(stderr, "%s\n", result.diagnostics[i].message);
+
+    ok = result.status == ASM_OK;
+    if (ok){
+        ok = write_all(STDOUT_FILENO, result.object_text, result.object_text_len)
+             && write_symbols(ent_fd >= 0 ? ent_fd : STDOUT_FILENO, ent_fd >= 0 ? NULL : PIPE_ENTRIES_TAG,
+                              result.entries, result.entries_cnt)
+             && write_symbols(ext_fd >= 0 ? ext_fd : STDOUT_FILENO, ext_fd >= 0 ? NULL : PIPE_EXTERNALS_TAG,
+                              result.externals, result.externals_cnt);
+        if (!ok)
+            fprintf(stderr, "[x] Cannot write the outputs\n");
+    }
+
+    free_asm_result(&result);
+    return ok;
+}
@@ -0,0 +1,32 @@
+/*
+ * Pipeline mode (--pipe): the source is read from the standard input and the outputs are written
+ * to the standard output, no file is created
+ *
+ * The standard output holds the object file (.ob format), followed by every section that is not sent
+ * to its own file descriptor, each one introduced by a tag line: "#ent" for the entries, "#ext" for
+ * the external references (a tag can't be mistaken for a line of a section, they never start with '#').
+ * When both the entries and the externals have their own descriptor, the standard output is exactly the object file.
+ * The messages of the assembler are written to the standard error.
+ */
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdbool.h>
+
+#define PIPE_ENTRIES_TAG "#ent\n"
+#define PIPE_EXTERNALS_TAG "#ext\n"
+
+/*
+ * Assemble the standard input to the standard output
+ *
+ * Args:
+ * ent_fd - File descriptor where the entries (.ent format) are written, -1 to tag them on the standard output
+ * ext_fd - File descriptor where the external references (.ext format) are written, -1 to tag them on the standard output
+ * group_externals - True to group the external references by label
+ *
+ * Return:
+ * False if the source could not be assembled
+ */
+bool run_pipeline(int ent_fd, int ext_fd, bool group_externals);
+
+#endif
@@ -0,0 +1,287 @@
+/*
+ * Scanner of the source files
+ * Every block of 32 bytes is turned into bit masks (one bit per byte: line breaks, whitespaces,
+ * comment starts, colons, double quotes), then the lines of the block are found from the masks.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include "errors.h"
+#include "globals.h"
+#include "labels.h"
+#include "scanner.h"
+
+/* The vector paths need the x86 intrinsics, AVX2 is chosen at runtime if the CPU has it */
+#if defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+#define SCANNER_SIMD
+#include <immintrin.h>
+#endif
+
+#define BLOCK_SIZE 32
+#define LINES_INIT_CAPACITY 1024
+#define QUOTE_CHAR '"'
+
+/*
+ * Bit masks of a block, bit i is set if byte i of the block is:
+ *
+ * Attributes:
+ * breaks - A line break
+ * words - Not a whitespace
+ * comments - A comment start
+ * colons - A colon
+ * quotes - A double quote
+ */
+typedef struct Masks{
+	uint32_t breaks;
+	uint32_t words;
+	uint32_t comments;
+	uint32_t colons;
+	uint32_t quotes;
+} Masks;
+
+/*
+ * State of the scanner over a file
+ *
+ * Attributes:
+ * lines - The lines found so far (reallocated as it grows)
+ * cnt - Number of lines
+ * cap - Number of allocated lines
+ * line_start - Beginning of the current line
+ * flags - Flags of the current line so far
+ * in_line - True once a non-whitespace character of the current line is read
+ */
+typedef struct Scanner{
+	SourceLine *lines;
+	int cnt;
+	int cap;
+	char *line_start;
+	int flags;
+	bool in_line;
+} Scanner;
+
+/*
+ * Index of the lowest set bit of a mask (not 0)
+ */
+static int lowest_bit_index(uint32_t mask){
+#ifdef __GNUC__
+    return __builtin_ctz(mask);
+#else
+    int i;
+
+    for (i = 0; (mask & 1) == 0; i++)
+        mask >>= 1;
+    return i;
+#endif
+}
+
+/*
+ * True if a mask has an odd number of set bits
+ */
+static bool odd_bits(uint32_t mask){
+#ifdef __GNUC__
+    return __builtin_parity(mask);
+#else
+    bool odd;
+
+    for (odd = false; mask != 0; mask &= mask - 1)
+        odd = !odd;
+    return odd;
+#endif
+}
+
+/*
+ * Build the masks of the first <n> bytes of a block, one byte at a time
+ */
+static void scalar_masks(Masks *m, char *block, int n){
+    uint32_t bit;
+    int i;
+    char ch;
+
+    memset(m, 0, sizeof(Masks));
+    for (i = 0, bit = 1; i < n; i++, bit <<= 1){
+        ch = block[i];
+        if (ch == '\n')
+            m->breaks |= bit;
+        else if (!isspace((unsigned char) ch)){
+            m->words |= bit;
+            if (ch == COMMENT_CHAR)
+                m->comments |= bit;
+            else if (ch == LABEL_CHAR)
+                m->colons |= bit;
+            else if (ch == QUOTE_CHAR)
+                m->quotes |= bit;
+        }
+    }
+}
+
+/*
+ * Build the masks of a whole block, one byte at a time
+ */
+static void scalar_block_masks(Masks *m, char *block){
+    scalar_masks(m, block, BLOCK_SIZE);
+}
+
+#ifdef SCANNER_SIMD
+/*
+ * Build the masks of 16 bytes with SSE2
+ * The whitespaces are ' ' and the characters from '\t' (9) to '\r' (13)
+ */
+static void sse2_masks(Masks *m, char *bytes, int shift){
+    __m128i v, spaces;
+
+    v = _mm_loadu_si128((const __m128i *) bytes);
+    spaces = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                          _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('\t' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('\r' + 1))));
+
+    m->breaks |= (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))) << shift;
+    m->words |= (uint32_t) (~_mm_movemask_epi8(spaces) & 0xFFFF) << shift;
+    m->comments |= (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(COMMENT_CHAR))) << shift;
+    m->colons |= (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(LABEL_CHAR))) << shift;
+    m->quotes |= (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(QUOTE_CHAR))) << shift;
+}
+
+/*
+ * Build the masks of a block with SSE2, 16 bytes at a time
+ */
+static void sse2_block_masks(Masks *m, char *block){
+    memset(m, 0, sizeof(Masks));
+    sse2_masks(m, block, 0);
+    sse2_masks(m, block + 16, 16);
+}
+
+/*
+ * Build the masks of a block with AVX2, in one step
+ */
+__attribute__((target("avx2")))
+static void avx2_block_masks(Masks *m, char *block){
+    __m256i v, spaces;
+
+    v = _mm256_loadu_si256((const __m256i *) block);
+    spaces = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                             _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('\t' - 1)),
+                                              _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), v)));
+
+    m->breaks = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+    m->words = ~(uint32_t) _mm256_movemask_epi8(spaces);
+    m->comments = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(COMMENT_CHAR)));
+    m->colons = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(LABEL_CHAR)));
+    m->quotes = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(QUOTE_CHAR)));
+}
+#endif
+
+/*
+ * Add the bytes of a block that belong to the current line to its flags
+ *
+ * Args:
+ * s - The scanner
+ * m - Masks of the block
+ * seg - Bits of the bytes of the current line
+ */
+static void add_segment(Scanner *s, Masks *m, uint32_t seg){
+    uint32_t first;
+
+    /* The first non-whitespace character tells if the line is blank or commented out */
+    if (!s->in_line && (m->words & seg) != 0){
+        first = m->words & seg;
+        first &= ~first + 1;
+        s->in_line = true;
+        if ((m->comments & first) == 0)
+            s->flags &= ~LINE_BLANK;
+    }
+
+    if ((m->colons & seg) != 0)
+        s->flags |= LINE_COLON;
+    if (odd_bits(m->quotes & seg))
+        s->flags ^= LINE_OPEN_QUOTE;
+}
+
+/*
+ * End the current line and start the next one
+ *
+ * Args:
+ * s - The scanner
+ * eol - End of the current line (its line break, or the end of the file)
+ */
+static void end_line(Scanner *s, char *eol){
+    SourceLine *line, *new_lines;
+
+    if (s->cnt == s->cap){
+        new_lines = (SourceLine *) realloc(s->lines, 2 * s->cap * sizeof(SourceLine));
+        if (new_lines == NULL){
+            free(s->lines);
+            raise_error("Internal error: cannot read the source file.");
+        }
+        memset(new_lines + s->cap, 0, s->cap * sizeof(SourceLine));
+        s->lines = new_lines;
+        s->cap *= 2;
+    }
+
+    line = &s->lines[s->cnt++];
+    line->start = s->line_start;
+    line->len = eol - s->line_start;
+    line->line_no = s->cnt;
+    line->flags = s->flags;
+
+    s->line_start = eol + 1;
+    s->flags = LINE_BLANK;
+    s->in_line = false;
+}
+
+/*
+ * Find the lines of a block from its masks
+ */
+static void scan_block(Scanner *s, Masks *m, char *block){
+    uint32_t rest, brk;
+
+    /* Cut the block at each line break */
+    for (rest = ~(uint32_t) 0; (m->breaks & rest) != 0; rest &= ~((brk << 1) - 1)){
+        brk = m->breaks & rest;
+        brk &= ~brk + 1;
+
+        add_segment(s, m, (brk - 1) & rest);
+        end_line(s, block + lowest_bit_index(brk));
+    }
+
+    if (rest != 0)
+        add_segment(s, m, rest);
+}
+
+SourceLine *scan_lines(char *content, size_t size, int *cnt){
+    Scanner s;
+    Masks m;
+    size_t pos;
+    void (*block_masks)(Masks *, char *);
+
+    s.cap = LINES_INIT_CAPACITY;
+    s.cnt = 0;
+    s.lines = (SourceLine *) calloc(s.cap, sizeof(SourceLine));
+    if (s.lines == NULL)
+        raise_error("Internal error: cannot read the source file.");
+    s.line_start = content;
+    s.flags = LINE_BLANK;
+    s.in_line = false;
+
+    block_masks = scalar_block_masks;
+#ifdef SCANNER_SIMD
+    block_masks = __builtin_cpu_supports("avx2") ? avx2_block_masks : sse2_block_masks;
+#endif
+
+    for (pos = 0; pos + BLOCK_SIZE <= size; pos += BLOCK_SIZE){
+        block_masks(&m, content + pos);
+        scan_block(&s, &m, content + pos);
+    }
+
+    /* The bytes after the last whole block */
+    if (pos < size){
+        scalar_masks(&m, content + pos, size - pos);
+        scan_block(&s, &m, content + pos);
+    }
+
+    /* The last line may have no line break */
+    if (s.line_start < content + size)
+        end_line(&s, content + size);
+
+    *cnt = s.cnt;
+    return s.lines;
+}
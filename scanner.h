@@ -0,0 +1,37 @@
+/*
+ * Scanner of the source files
+ * The content of a file is read 16 bytes at a time (32 with AVX2) to find the line breaks, and the
+ * comment starts, colons and double quotes of every line, before any line is lexed.
+ * The lexer then skips blank and commented out lines without reading them again.
+ * Where the vector instructions are not available, the same masks are built by a scalar loop.
+ */
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#include <stddef.h>
+#include "source.h"
+
+/* The line is blank or commented out (nothing but whitespaces before its first ';') */
+#define LINE_BLANK 1
+
+/* The line has a colon (it may define a label) */
+#define LINE_COLON 2
+
+/* The line has an odd number of double quotes */
+#define LINE_OPEN_QUOTE 4
+
+/*
+ * Split the content of a source file into lines
+ * An error is raised if there is no memory
+ *
+ * Args:
+ * content - Content of the file
+ * size - Size of <content>
+ * cnt - Where the number of lines is written
+ *
+ * Return:
+ * The lines (free them with free), only their <start>, <len>, <line_no> and <flags> are set
+ */
+SourceLine *scan_lines(char *content, size_t size, int *cnt);
+
+#endif
@@ -1,32 +1,373 @@
 /*
  * Second pass of the assembling, encode every line to the object (.ob) file.
  * Every code instruction (normal command) line is directly dumped into the object file in the right format.
+ * The object file is opened once and written through a buffered writer.
  * Every .entry instruction is directly dumped into an entries file (.ent)
- * Every use of an external label is dumped into a temporary externals file (.ext) that is renamed after
- * all the lines are parsed.
- * Data instruction are first encoded to a temporary file as raw bits. After reading the whole input file,
- * this temporary file will be parsed and converted to the right format in order to merge it to the object
- * file.
+ * Every use of an external label is recorded in memory, the externals file (.ext) is written at once
+ * after all the lines are parsed.
+ * The lines of a big file are encoded in chunks on several threads, the chunks are written in order.
+ * Data instruction are first encoded to an in-memory data image as raw bytes. After reading the whole
+ * input file, the image is dumped to the object file, after the code.
  *
  */
 #include <stdio.h>
 #include <stdlib.h>
-#include <ctype.h>
+#include <string.h>
 
 #include "encoder.h"
+#include "errors.h"
 #include "second_pass.h"
 #include "instructions.h"
 #include "labels.h"
+#include "source.h"
 #include "utils.h"
+#include "writer.h"
 #include "globals.h"
+#include "context.h"
+#include "stats.h"
+#include "binary.h"
+#include "chunks.h"
+#include "stream.h"
 
-void second_pass(char *fname, LabelsTable *labels_table_ptr, int ic_size, int dc_size){
-	FILE *fp, *obj_fp;
-    char *line_ptr; /* Hold the line strin */
-    size_t line_len; /* Maximum length of an instruction line */
-    size_t read_cnt; /* Counter of characters read from the file */
+/* Number of bytes of the spilled data image read back at once (a multiple of 4) */
+#define SPILL_BLOCK_SIZE 65536
 
-    char *label; /* Hold the label name */
+/*
+ * Name an output file: the base name of the source file followed by a suffix
+ *
+ * Args:
+ * basename - Base name of the outputs
+ * suffix - Suffix of the output file (".ob", ".ent"...)
+ *
+ * Return:
+ * The name, allocated from the arena of the context
+ */
+static char *output_name(char *basename, char *suffix){
+    char *name;
+
+    name = (char *) ctx_calloc(strlen(basename) + strlen(suffix) + 1, sizeof(char));
+    strcpy(name, basename);
+    strcat(name, suffix);
+    return name;
+}
+
+/*
+ * Create (or truncate) an output file that is only written at the end of the pass
+ * An error is raised if the file cannot be created
+ *
+ * Args:
+ * fname - Name of the file
+ */
+static void create_empty_output(char *fname){
+    FILE *fp;
+
+    fp = ctx_fopen(fname, "w");
+    if (fp == NULL){
+        report("[x] Cannot create output file %s\n", fname);
+        raise_error(NULL);
+    }
+    fclose(fp);
+}
+
+/*
+ * Record what the second pass produced in the statistics of the file
+ *
+ * Args:
+ * stats - Statistics of the file (nothing is done if NULL)
+ * tbl - The labels table
+ * code_cnt - Number of encoded instructions
+ * data_len - Number of encoded data bytes
+ * main_of, entries_of, external_of - The output files
+ * binary_of - The binary object file, NULL if there is none
+ */
+static void record_output_stats(Stats *stats, LabelsTable *tbl, int code_cnt, int data_len,
+                                char *main_of, char *entries_of, char *external_of, char *binary_of){
+    int i;
+
+    if (stats == NULL)
+        return;
+
+    stats->code_words = code_cnt;
+    stats->data_bytes = data_len;
+    stats->labels = tbl->count;
+    for (i = 0; i < tbl->count; i++){
+        if (tbl->labels[i].is_external)
+            stats->externs++;
+        if (tbl->labels[i].is_entry)
+            stats->entries++;
+    }
+
+    stats->ob_bytes = get_file_size(main_of);
+    stats->ent_bytes = get_file_size(entries_of);
+    stats->ext_bytes = get_file_size(external_of);
+    if (binary_of != NULL)
+        stats->bin_bytes = get_file_size(binary_of);
+}
+
+/*
+ * Copy the outputs of the second pass to the in-memory result of the context
+ *
+ * Args:
+ * result - The result
+ * tbl - The labels table
+ * code - The encoded instructions
+ * code_cnt - Number of encoded instructions
+ * data_img - The data image
+ * ext_refs - The external references
+ */
+static void collect_outputs(AsmResult *result, LabelsTable *tbl, WORD_32 *code, int code_cnt, DataImage *data_img,
+                            ExternalRefs *ext_refs){
+    unsigned char *bytes;
+    int i;
+
+    result->code = (unsigned char *) malloc(4 * code_cnt + 1);
+    result->data = (unsigned char *) malloc(data_img->len + 1);
+    if (result->code == NULL || result->data == NULL)
+        raise_error("Internal error: out of memory.");
+
+    /* Lowest byte first, as in the object file */
+    bytes = result->code;
+    for (i = 0; i < code_cnt; i++, bytes += 4){
+        bytes[0] = code[i] & 0xFF;
+        bytes[1] = (code[i] >> 8) & 0xFF;
+        bytes[2] = (code[i] >> 16) & 0xFF;
+        bytes[3] = (code[i] >> 24) & 0xFF;
+    }
+    result->code_size = 4 * code_cnt;
+
+    memcpy(result->data, data_img->bytes, data_img->len);
+    result->data_size = data_img->len;
+
+    for (i = 0; i < tbl->count; i++)
+        if (tbl->labels[i].is_entry)
+            add_asm_symbol(&result->entries, &result->entries_cnt, get_label_name(tbl, &tbl->labels[i]), tbl->labels[i].value);
+
+    for (i = 0; i < ext_refs->cnt; i++)
+        add_asm_symbol(&result->externals, &result->externals_cnt,
+                       get_label_name(tbl, &tbl->labels[ext_refs->refs[i].label]), ext_refs->refs[i].addr);
+}
+
+/*
+ * Free the labels table, the data image and the external references once the pass is done
+ *
+ * Args:
+ * ctx - Context of the file (NULL if there is none), it stops tracking them
+ * tbl - The labels table
+ * data_img - The data image
+ * ext_refs - The external references
+ */
+static void free_pass_outputs(Context *ctx, LabelsTable *tbl, DataImage *data_img, ExternalRefs *ext_refs){
+    if (ctx != NULL){
+        ctx->labels = NULL;
+        ctx->data_img = NULL;
+        ctx->ext_refs = NULL;
+    }
+
+    free_external_refs(ext_refs);
+    free_data_image(data_img);
+    free_labels_table(tbl);
+}
+
+/*
+ * Outputs of the second pass over a chunk
+ *
+ * Attributes:
+ * tbl - The labels table (the chunks only read it)
+ * code - Where the instructions of the chunk are encoded (its part of the code section)
+ * code_cnt - Number of instructions of the chunk
+ * first_addr - Address of the first instruction of the chunk
+ * data_size - Number of data bytes of the chunk
+ * with_object - True if the chunk formats its part of the object file
+ * obj_writer - Part of the object file formatted by the chunk (in memory)
+ * ext_refs - External references of the chunk
+ * data_img - Data of the chunk, until the chunks are merged
+ * image - The whole data image, once the chunks are merged
+ * data_start - First byte of the data image formatted by the chunk
+ * data_end - Byte after the last byte of the data image formatted by the chunk
+ * dc_offset - Address of the first data cell
+ * line_ix - Index of the line being encoded (the line that stopped the chunk if it failed)
+ */
+typedef struct ChunkOutput{
+	LabelsTable *tbl;
+	WORD_32 *code;
+	int code_cnt;
+	int first_addr;
+	int data_size;
+	bool with_object;
+	Writer *obj_writer;
+	ExternalRefs *ext_refs;
+	DataImage *data_img;
+	DataImage *image;
+	int data_start;
+	int data_end;
+	int dc_offset;
+	int line_ix;
+} ChunkOutput;
+
+/*
+ * Free the buffers of a chunk
+ */
+static void free_chunk_output(Chunk *chunk){
+    ChunkOutput *out;
+
+    out = (ChunkOutput *) chunk->data;
+    discard_writer(out->obj_writer);
+    free_external_refs(out->ext_refs);
+    free_data_image(out->data_img);
+}
+
+/*
+ * Encode the lines of a chunk into its part of the code section and its own buffers,
+ * then format its instructions
+ * The .entry lines are left to the merge, the labels table is not written while the chunks run
+ */
+static void encode_chunk(Chunk *chunk){
+    ChunkOutput *out;
+    SourceLine *line;
+    ArenaMark line_mark;
+    int code_cnt;
+
+    out = (ChunkOutput *) chunk->data;
+    out->ext_refs = create_external_refs();
+    out->data_img = create_data_image(out->data_size);
+    if (out->with_object)
+        out->obj_writer = create_writer(NULL);
+
+    code_cnt = 0;
+    line_mark = ctx_mark();
+    for (out->line_ix = chunk->first_line; out->line_ix < chunk->end_line; out->line_ix++){
+        line = &chunk->src->lines[out->line_ix];
+        ctx_release(line_mark);
+
+        if (line->kind == DATA_LINE)
+            encode_data_instruction(line, out->data_img);
+        else if (line->kind == CODE_LINE){
+            out->code[code_cnt] = encode_instruction_line(line, out->tbl, out->first_addr + 4 * code_cnt, out->ext_refs);
+            code_cnt++;
+        }
+    }
+
+    if (out->obj_writer != NULL)
+        dump_words(out->code, code_cnt, out->obj_writer, out->first_addr);
+}
+
+/*
+ * Format the range of the data image of a chunk
+ */
+static void format_data_chunk(Chunk *chunk){
+    ChunkOutput *out;
+    DataImage range;
+
+    out = (ChunkOutput *) chunk->data;
+    range.bytes = out->image->bytes + out->data_start;
+    range.len = range.size = out->data_end - out->data_start;
+
+    out->obj_writer->len = 0;
+    dump_data_image(&range, out->obj_writer, out->dc_offset + out->data_start);
+}
+
+/*
+ * Second pass over chunks of lines on worker threads: every chunk encodes its instructions at the
+ * addresses summed up from the previous chunks, its data and its external references in buffers of its own,
+ * then the buffers are appended to the outputs in chunk order, so that the outputs are the same as
+ * with a serial pass. The data image is then formatted in ranges on the workers too.
+ * The pass stops at the first line that fails, as a serial pass would.
+ *
+ * Args:
+ * ctx - Context of the file
+ * src - The source file
+ * tbl - The labels table
+ * chunks - The chunks of <src>
+ * chunks_cnt - Number of chunks
+ * code - The code section
+ * obj_writer - Writer of the object file (its title is written), NULL if the object file is not needed
+ * ext_refs - The external references of the file
+ * data_img - The data image (empty)
+ * dc_offset - Address of the first data cell
+ */
+static void second_pass_chunks(Context *ctx, SourceFile *src, LabelsTable *tbl, Chunk *chunks, int chunks_cnt,
+                               WORD_32 *code, Writer *obj_writer, ExternalRefs *ext_refs, DataImage *data_img, int dc_offset){
+    ChunkOutput *outputs, *out;
+    SourceLine *line;
+    int i, j, done, end, code_cnt;
+
+    /* Prefix sum: each chunk starts where the previous chunks end */
+    outputs = (ChunkOutput *) ctx_calloc(chunks_cnt, sizeof(ChunkOutput));
+    code_cnt = 0;
+    for (i = 0; i < chunks_cnt; i++){
+        out = &outputs[i];
+        out->tbl = tbl;
+        out->code = code + code_cnt;
+        out->first_addr = 100 + 4 * code_cnt;
+        out->with_object = obj_writer != NULL;
+        out->dc_offset = dc_offset;
+
+        for (j = chunks[i].first_line; j < chunks[i].end_line; j++){
+            line = &src->lines[j];
+            if (line->kind == CODE_LINE)
+                out->code_cnt++;
+            else if (line->kind == DATA_LINE)
+                out->data_size += get_data_size(line);
+        }
+        code_cnt += out->code_cnt;
+
+        chunks[i].data = out;
+        chunks[i].free_data = free_chunk_output;
+    }
+
+    done = run_chunks(chunks, chunks_cnt, ctx->line_workers, encode_chunk);
+
+    /* Merge in chunk order, up to the line that stopped the first failed chunk */
+    for (i = 0; i <= done && i < chunks_cnt; i++){
+        out = &outputs[i];
+
+        /* The entries only set a flag of the labels, they are marked once the workers are done */
+        end = i < done ? chunks[i].end_line : out->line_ix;
+        for (j = chunks[i].first_line; j < end; j++)
+            if (src->lines[j].kind == ENTRY_LINE)
+                mark_label_as_entry(tbl, src->lines[j].operands[0].text, src->lines[j].line_no);
+
+        add_to_log(ctx, chunks[i].ctx->log, chunks[i].ctx->log_len);
+        if (i == done)
+            raise_error(NULL); /* The chunks are freed with the pass */
+
+        if (obj_writer != NULL)
+            write_to_writer(obj_writer, out->obj_writer->buf, out->obj_writer->len);
+        append_external_refs(ext_refs, out->ext_refs);
+        append_to_data_image(data_img, out->data_img->bytes, out->data_img->len);
+
+        free_data_image(out->data_img);
+        out->data_img = NULL;
+    }
+
+    /* Format the data image in ranges of whole lines (4 bytes) */
+    if (obj_writer != NULL){
+        for (i = 0; i < chunks_cnt; i++){
+            out = &outputs[i];
+            out->image = data_img;
+            out->data_start = (int) ((long) data_img->len * i / chunks_cnt) & ~3;
+            out->data_end = i + 1 < chunks_cnt ? (int) ((long) data_img->len * (i + 1) / chunks_cnt) & ~3 : data_img->len;
+        }
+
+        done = run_chunks(chunks, chunks_cnt, ctx->line_workers, format_data_chunk);
+        if (done < chunks_cnt){
+            add_to_log(ctx, chunks[done].ctx->log, chunks[done].ctx->log_len);
+            raise_error(NULL);
+        }
+
+        for (i = 0; i < chunks_cnt; i++)
+            write_to_writer(obj_writer, outputs[i].obj_writer->buf, outputs[i].obj_writer->len);
+    }
+
+    free_chunks(chunks, chunks_cnt);
+}
+
+void second_pass(SourceFile *src, LabelsTable *labels_table_ptr, int ic_size, int dc_size){
+	Writer *obj_writer; /* Object output file, NULL if the object file is not needed */
+	char title[32]; /* Title line of the object file */
+    SourceLine *line; /* Current parsed line */
+    ArenaMark line_mark; /* Arena position before each line, the memory used by a line is released after it */
+    int i;
 
     int ic; /* Instruction counter & Data counter */
 
@@ -34,109 +375,288 @@ void second_pass(char *fname, LabelsTable *labels_table_ptr, int ic_size, int dc
     char *main_of; /* main output file */
     char *entries_of; /* entries output file */
     char *external_of; /* externals output file */
+    char *binary_of; /* binary object file, NULL if it's not needed */
+    Context *ctx; /* Context of the file */
+    AsmResult *result; /* In-memory outputs, NULL if the outputs are files */
 
-    BITMAP_32 *bitmap; /* 32-Bits array */
+    WORD_32 *code; /* Encoded instructions (code section) */
+    int code_cnt; /* Number of encoded instructions */
+    DataImage *data_img; /* Encoded data section */
+    ExternalRefs *ext_refs; /* Uses of the external labels, in source order */
+    Chunk *chunks; /* Chunks of lines of a big file, NULL if the file is not split */
+    int chunks_cnt;
 
 	int dc_offset = ic_size;
 
+    start_phase(ctx_stats(), SECOND_PASS_PHASE);
+
     /* Init variables */
     ic = 100;
-	line_len = LINE_MAX_SIZE;
-    line_ptr = (char *) calloc(line_len, sizeof(char));
-
-	/* Check if the file is valid */
-	fp = fopen(fname, "r");
-	if (!fp){
-		printf("Bad file: %s\n", fname);
-        return;
-    }
 
-    /* Create output files */
-	file_basename = get_basename(fname);
+    /* Create output files, next to the source file unless the context names them */
+    ctx = get_current_context();
+	file_basename = ctx != NULL && ctx->out_basename != NULL ? ctx->out_basename : get_basename(src->fname);
 
     /* Main output file is file basename with .ob at the end */
-    main_of = (char *) calloc(strlen(file_basename)+4, sizeof(char));
-    strcpy(main_of, file_basename);
-    strcat(main_of, ".ob");
+    main_of = output_name(file_basename, ".ob");
 
     /* Entries output file is file basename with .ent at the end */
-    entries_of = (char *) calloc(strlen(file_basename)+5, sizeof(char));
-    strcpy(entries_of, file_basename);
-    strcat(entries_of, ".ent");
+    entries_of = output_name(file_basename, ".ent");
 
     /* External output file is file basename with .ext at the end */
-    external_of = (char *) calloc(strlen(file_basename)+5, sizeof(char));
-    strcpy(external_of, file_basename);
-    strcat(external_of, ".ext");
+    external_of = output_name(file_basename, ".ext");
 
-    /* Create the files */
-	obj_fp = fopen(main_of, "w"); /* Object file */
-	fprintf(obj_fp, "%d %d\n", ic_size, dc_size); /* Write title to the object file */
-	fclose(obj_fp);
-    fopen(entries_of, "w"); /* Entries file */
-    fopen(external_of, "w"); /* Externals file */
-    create_tmp_files(); /* Temporary files */
+    /* Binary object file is file basename with .bin at the end, only with --binary */
+    binary_of = ctx != NULL && ctx->binary_output ? output_name(file_basename, BINARY_SUFFIX) : NULL;
 
-	while ((read_cnt = get_line_wout_spaces(&line_ptr, &line_len, fp)) != -1) {
+    /* Create the files, in memory only the object file is rendered (if it was asked for) */
+    result = ctx != NULL ? ctx->result : NULL;
+    if (result == NULL){
+        obj_writer = create_writer(main_of); /* Object file, kept open for the whole pass */
+        create_empty_output(entries_of); /* Entries file */
+        create_empty_output(external_of); /* Externals file */
+    }
+    else
+        obj_writer = ctx->object_text ? create_writer(NULL) : NULL;
 
-		/* We assume no one modified the input file between the first and the second pass */
-		/* Thus we're not checking syntax errors again */
+    if (obj_writer != NULL){
+        sprintf(title, "%d %d\n", ic_size, dc_size); /* Write title to the object file */
+        write_to_writer(obj_writer, title, strlen(title));
+    }
+    data_img = create_data_image(dc_size); /* Data section, in memory */
+    code = (WORD_32 *) ctx_calloc(ic_size / 4 + 1, sizeof(WORD_32)); /* Code section, in memory */
+    code_cnt = 0;
+    ext_refs = create_external_refs(); /* External references, in memory */
 
-        /* Clean the line (remove unwanted characters) */
-        line_ptr = clean_str(line_ptr);
+    /* Freed by the context if an error stops the pass */
+    if (ctx != NULL){
+        ctx->obj_writer = obj_writer;
+        ctx->ext_refs = ext_refs;
+        ctx->data_img = data_img;
+    }
 
-        /* Ignore every irrelevant line (comments/empty...) */
-        if (!relevant_line(line_ptr))
-            continue;
+    /* Big files are encoded on several threads, the in-memory result is only filled by a serial pass */
+    chunks = ctx != NULL && result == NULL ? create_chunks(src, ctx->line_workers, &chunks_cnt) : NULL;
+    if (chunks != NULL){
+        second_pass_chunks(ctx, src, labels_table_ptr, chunks, chunks_cnt, code, obj_writer, ext_refs, data_img, dc_offset);
+        code_cnt = ic_size / 4;
+    }
 
-		/* If it's an external instruction, ignore it */
-		if (is_external_instruction(line_ptr))
-			continue;
+    line_mark = ctx_mark();
+	for (i = 0; chunks == NULL && i < src->lines_cnt; i++) {
+        line = &src->lines[i];
+        ctx_release(line_mark);
 
-        /* If it's an entry instruction - mark the symbol as entry */
-        if (is_entry_instruction(line_ptr)){
-            label = get_entry_label(line_ptr);
-            mark_label_as_entry(labels_table_ptr, label);
-            continue;
-        }
+		/* We assume the file was checked before the first pass */
+		/* Thus we're not checking syntax errors again */
 
-        /* If the line is a labelled line, skip the label */
-        if (contain_label(line_ptr)){
-            /* Skip the label itself */
-            while (*line_ptr++ != ':'){}
-            /* Skip the whitespaces after the label */
-            while ( isspace(*line_ptr) )
-                line_ptr++;
-        }
+        switch (line->kind) {
+            /* Ignore every irrelevant line (comments/empty...) and external instructions */
+            case IRRELEVANT_LINE:
+            case EXTERNAL_LINE:
+                break;
 
-        /* If it's a data instruction, add the data to the memory */
-        if (is_data_instruction(line_ptr)){
-            tmp_dump_data_instruction(line_ptr);
-            continue;
+            /* If it's an entry instruction - mark the symbol as entry */
+            case ENTRY_LINE:
+                mark_label_as_entry(labels_table_ptr, line->operands[0].text, line->line_no);
+                break;
+
+            /* If it's a data instruction, add the data to the memory */
+            case DATA_LINE:
+                encode_data_instruction(line, data_img);
+                break;
+
+            case CODE_LINE:
+                /* Encode the line to binary, the code section is dumped at once after the last line */
+                code[code_cnt++] = encode_instruction_line(line, labels_table_ptr, ic, ext_refs);
+
+                /* Increment instruction counter */
+                ic += 4;
+                break;
         }
+    }
 
-        /* === If we got here, then it's a code instruction === */
+    /* Dump the code section, then the data image after it (the chunks already did) */
+    if (obj_writer != NULL && chunks == NULL){
+        dump_words(code, code_cnt, obj_writer, 100);
+        dump_data_image(data_img, obj_writer, dc_offset);
+    }
 
-        /* Encode the line to binary */
-        bitmap = encode_instruction_line(line_ptr, labels_table_ptr, ic);
+    /* Group the references of each label together, if asked for */
+    if (ctx != NULL && ctx->group_externals)
+        group_external_refs(ext_refs, labels_table_ptr->count);
 
-        /* Add the bitmap to the file */
-        dump_bitmap(bitmap, main_of, ic, 4);
+    /* In memory, hand the outputs over to the result */
+    if (result != NULL){
+        if (obj_writer != NULL)
+            result->object_text = take_writer_buffer(obj_writer, &result->object_text_len);
+        ctx->obj_writer = NULL;
+        collect_outputs(result, labels_table_ptr, code, code_cnt, data_img, ext_refs);
 
-        /* Increment instruction counter */
-        ic += 4;
+        end_phase(ctx_stats(), SECOND_PASS_PHASE);
+        free_pass_outputs(ctx, labels_table_ptr, data_img, ext_refs);
+        return;
     }
 
-    /* Merge the temporary data file to the output file */
-    merge_tmp_data_file(main_of, dc_offset);
+    /* Flush and close the object file */
+    if (ctx != NULL)
+        ctx->obj_writer = NULL;
+    close_writer(obj_writer);
 
     /* Create entries file */
     dump_entry_labels(labels_table_ptr, entries_of);
 
     /* Create externals file */
-    rename_externals_file(external_of);
+    dump_external_refs(ext_refs, labels_table_ptr, external_of);
+
+    /* Create the binary object file, the code words are not needed anymore */
+    if (binary_of != NULL)
+        dump_binary_object(binary_of, code, code_cnt, data_img, labels_table_ptr, ext_refs);
+
+    record_output_stats(ctx_stats(), labels_table_ptr, code_cnt, data_img->len, main_of, entries_of, external_of, binary_of);
+    end_phase(ctx_stats(), SECOND_PASS_PHASE);
+
+    free_pass_outputs(ctx, labels_table_ptr, data_img, ext_refs);
+}
+
+/*
+ * Copy the data image spilled to a temporary file into the object file
+ *
+ * Args:
+ * data_spill - Writer of the temporary file
+ * obj_writer - Writer of the object file
+ * dc_offset - Address of the first data cell
+ *
+ * Return:
+ * Number of bytes of the data image
+ */
+static int dump_spilled_data(Writer *data_spill, Writer *obj_writer, int dc_offset){
+    DataImage block; /* Bytes read back at once */
+    size_t n;
+    int data_len;
+
+    flush_writer(data_spill);
+    rewind(data_spill->fp);
+
+    /* A block is a multiple of 4 bytes, so only the last line of the image may be shorter */
+    block.size = SPILL_BLOCK_SIZE;
+    block.bytes = (unsigned char *) ctx_calloc(SPILL_BLOCK_SIZE, sizeof(unsigned char));
+    for (data_len = 0; (n = fread(block.bytes, 1, SPILL_BLOCK_SIZE, data_spill->fp)) > 0; data_len += n){
+        block.len = (int) n;
+        dump_data_image(&block, obj_writer, dc_offset + data_len);
+    }
+
+    if (ferror(data_spill->fp))
+        raise_error("Internal error: cannot read the data image back.");
+
+    return data_len;
+}
+
+void second_pass_stream(char *fname, LabelsTable *labels_table_ptr, int ic_size, int dc_size){
+	Writer *obj_writer; /* Object output file */
+	Writer *ext_writer; /* Externals output file */
+	Writer *data_spill; /* Temporary file holding the data image */
+	char title[32]; /* Title line of the object file */
+    SourceStream *st; /* The file, read through a window */
+    SourceFile *window; /* Lines of the current window */
+    SourceLine *line; /* Current parsed line */
+    ArenaMark line_mark; /* Arena position before each line, the memory used by a line is released after it */
+    int i;
+
+    int ic; /* Instruction counter */
+    int data_len; /* Number of data bytes in the spilled data image */
+
+	char *file_basename; /* Base name of the processed file */
+    char *main_of; /* main output file */
+    char *entries_of; /* entries output file */
+    char *external_of; /* externals output file */
+    Context *ctx; /* Context of the file */
+
+    DataImage *data_img; /* Data of the current window, until it is spilled */
+    ExternalRefs *ext_refs; /* Uses of the external labels not written yet */
+
+    start_phase(ctx_stats(), SECOND_PASS_PHASE);
+
+    ic = 100;
+
+    ctx = get_current_context();
+	file_basename = ctx->out_basename != NULL ? ctx->out_basename : get_basename(fname);
+    main_of = output_name(file_basename, ".ob");
+    entries_of = output_name(file_basename, ".ent");
+    external_of = output_name(file_basename, ".ext");
+
+    /* Every writer is freed by the context if an error stops the pass */
+    ctx->obj_writer = obj_writer = create_writer(main_of);
+    create_empty_output(entries_of);
+    ctx->ext_writer = ext_writer = create_writer(external_of);
+    ctx->data_spill = data_spill = create_temp_writer();
+    ctx->data_img = data_img = create_data_image(dc_size < STREAM_WINDOW_SIZE ? dc_size : STREAM_WINDOW_SIZE);
+    ctx->ext_refs = ext_refs = create_external_refs();
+
+    sprintf(title, "%d %d\n", ic_size, dc_size); /* Write title to the object file */
+    write_to_writer(obj_writer, title, strlen(title));
+
+    /* The code goes straight to the object file, the data after the code once every line is encoded */
+    st = open_source_stream(fname);
+    line_mark = ctx_mark();
+    while ((window = next_source_window(st)) != NULL){
+        for (i = 0; i < window->lines_cnt; i++){
+            line = &window->lines[i];
+            ctx_release(line_mark);
+
+            switch (line->kind) {
+                case ENTRY_LINE:
+                    mark_label_as_entry(labels_table_ptr, line->operands[0].text, line->line_no);
+                    break;
+
+                case DATA_LINE:
+                    encode_data_instruction(line, data_img);
+                    break;
+
+                case CODE_LINE:
+                    dump_word(encode_instruction_line(line, labels_table_ptr, ic, ext_refs), obj_writer, ic);
+                    ic += 4;
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        /* Spill the data of the window, and write its external references unless they are grouped */
+        write_to_writer(data_spill, (char *) data_img->bytes, data_img->len);
+        data_img->len = 0;
+        if (!ctx->group_externals){
+            write_external_refs(ext_refs, labels_table_ptr, ext_writer);
+            ext_refs->cnt = 0;
+        }
+    }
+    close_source_stream(st);
+
+    data_len = dump_spilled_data(data_spill, obj_writer, ic_size);
+    discard_writer(data_spill);
+    ctx->data_spill = NULL;
+
+    /* The file is read twice, it must not change in between */
+    if (ic - 100 != ic_size || data_len != dc_size){
+        report("[x] File %s changed while it was assembled\n", fname);
+        raise_error(NULL);
+    }
+
+    ctx->obj_writer = NULL;
+    close_writer(obj_writer);
+
+    if (ctx->group_externals){
+        group_external_refs(ext_refs, labels_table_ptr->count);
+        write_external_refs(ext_refs, labels_table_ptr, ext_writer);
+    }
+    ctx->ext_writer = NULL;
+    close_writer(ext_writer);
+
+    dump_entry_labels(labels_table_ptr, entries_of);
+
+    record_output_stats(ctx_stats(), labels_table_ptr, ic_size / 4, data_len, main_of, entries_of, external_of, NULL);
+    end_phase(ctx_stats(), SECOND_PASS_PHASE);
 
-    /* Close input file and delete temporary ones */
-	fclose(fp);
-    delete_tmp_files();
+    free_pass_outputs(ctx, labels_table_ptr, data_img, ext_refs);
 }
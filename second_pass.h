@@ -3,17 +3,28 @@
 
 #include <stdio.h>
 #include "labels.h"
+#include "source.h"
 
 /*
  * Second pass of the assembling, encode every line to the object (.ob) file.
  * Every code instruction (normal command) line is directly dumped into the object file in the right format.
+ * The object file is opened once and written through a buffered writer.
  * Every .entry instruction is directly dumped into an entries file (.ent)
- * Every use of an external label is dumped into a temporary externals file (.ext) that is renamed after
- * all the lines are parsed.
- * Data instruction are first encoded to a temporary file as raw bits. After reading the whole input file,
- * this temporary file will be parsed and converted to the right format in order to merge it to the object
- * file.
+ * Every use of an external label is recorded in memory, the externals file (.ext) is written at once
+ * after all the lines are parsed.
+ * Data instruction are first encoded to an in-memory data image as raw bytes. After reading the whole
+ * input file, the image is dumped to the object file, after the code.
  *
  */
-void second_pass(char *fname, LabelsTable *labels_table_ptr, int ic_size, int dc_size);
+void second_pass(SourceFile *src, LabelsTable *labels_table_ptr, int ic_size, int dc_size);
+
+/*
+ * Second pass over a file streamed through a window of lines (see stream.h), the outputs are the
+ * same as the ones of second_pass.
+ * The code words are written to the object file as the lines are encoded, the data image of each
+ * window is spilled to a temporary file with no name, then copied to the object file after the code.
+ * The external references of each window are written to the externals file before the next window
+ * is read (with --group-externals, they are kept until the end to be grouped).
+ */
+void second_pass_stream(char *fname, LabelsTable *labels_table_ptr, int ic_size, int dc_size);
 #endif
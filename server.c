@@ -0,0 +1,687 @@
+/*
+ * Persistent assembler server over a Unix socket (--server), and its client (--client)
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "errors.h"
+#include "first_pass.h"
+#include "second_pass.h"
+#include "source.h"
+#include "context.h"
+#include "jobs.h"
+#include "stats.h"
+#include "binary.h"
+#include "utils.h"
+#include "server.h"
+
+#define HEADER_LINE_MAX_SIZE 4096
+#define IO_BUF_SIZE 65536
+#define LISTEN_BACKLOG 64
+#define SOURCE_MAX_SIZE (1UL << 30) /* Biggest inline source accepted (1 GB) */
+
+/*
+ * Buffered reading side of a connection
+ *
+ * Attributes:
+ * fd - The socket
+ * buf - Received bytes that were not consumed yet
+ * len - Number of bytes in <buf>
+ * pos - Position of the next unconsumed byte in <buf>
+ */
+typedef struct Connection{
+	int fd;
+	char buf[IO_BUF_SIZE];
+	size_t len;
+	size_t pos;
+} Connection;
+
+/*
+ * Represent a request, as read from its header
+ *
+ * Attributes:
+ * name - Source file to assemble (or name of the inline source)
+ * outdir - Directory of the outputs, empty to write them next to the source file
+ * binary_output - True if the binary object file is written too
+ * has_source - True if the source follows the header
+ * source_size - Size of the inline source
+ * shutdown - True if this is a shutdown request
+ */
+typedef struct Request{
+	char name[HEADER_LINE_MAX_SIZE];
+	char outdir[HEADER_LINE_MAX_SIZE];
+	bool binary_output;
+	bool has_source;
+	unsigned long source_size;
+	bool shutdown;
+} Request;
+
+/*
+ * State of a server worker thread, kept for the whole life of the server
+ *
+ * Attributes:
+ * listen_fd - The listening socket, shared by every worker
+ * ctx - Context reused by every request of the worker (its arena stays allocated)
+ */
+typedef struct Worker{
+	int listen_fd;
+	Context *ctx;
+} Worker;
+
+/*
+ * Read the next byte of a connection
+ *
+ * Return:
+ * The byte, EOF if the connection is closed
+ */
+static int read_byte(Connection *conn){
+    ssize_t n;
+
+    if (conn->pos == conn->len){
+        do {
+            n = read(conn->fd, conn->buf, IO_BUF_SIZE);
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0)
+            return EOF;
+        conn->len = n;
+        conn->pos = 0;
+    }
+    return (unsigned char) conn->buf[conn->pos++];
+}
+
+/*
+ * Read a header line, without its line break
+ *
+ * Args:
+ * conn - The connection
+ * line - Buffer of HEADER_LINE_MAX_SIZE characters where the line is written
+ *
+ * Return:
+ * False if the connection is closed or the line is too long
+ */
+static bool read_line(Connection *conn, char *line){
+    int c, len;
+
+    for (len = 0; (c = read_byte(conn)) != EOF && c != '\n'; len++){
+        if (len == HEADER_LINE_MAX_SIZE - 1)
+            return false;
+        line[len] = (char) c;
+    }
+    line[len] = '\0';
+    return c == '\n';
+}
+
+/*
+ * Read exactly <size> bytes of a connection
+ *
+ * Return:
+ * False if the connection is closed before
+ */
+static bool read_exact(Connection *conn, char *buf, size_t size){
+    size_t cnt;
+    ssize_t n;
+
+    /* Bytes already received with the header first */
+    cnt = conn->len - conn->pos < size ? conn->len - conn->pos : size;
+    memcpy(buf, conn->buf + conn->pos, cnt);
+    conn->pos += cnt;
+
+    while (cnt < size){
+        n = read(conn->fd, buf + cnt, size - cnt);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        cnt += n;
+    }
+    return true;
+}
+
+/*
+ * Write a whole buffer to a socket
+ *
+ * Return:
+ * False if the peer is gone
+ */
+static bool write_all(int fd, char *buf, size_t size){
+    ssize_t n;
+
+    while (size > 0){
+        n = write(fd, buf, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        buf += n;
+        size -= n;
+    }
+    return true;
+}
+
+/*
+ * Fill the address of a socket
+ *
+ * Return:
+ * False if the path is too long for a Unix socket
+ */
+static bool make_address(char *socket_path, struct sockaddr_un *addr){
+    if (strlen(socket_path) >= sizeof(addr->sun_path)){
+        printf("[x] Socket path too long: %s\n", socket_path);
+        return false;
+    }
+
+    memset(addr, 0, sizeof(struct sockaddr_un));
+    addr->sun_family = AF_UNIX;
+    strcpy(addr->sun_path, socket_path);
+    return true;
+}
+
+/*
+ * Connect to a server
+ *
+ * Return:
+ * The connected socket, -1 if the server cannot be reached
+ */
+static int connect_to_server(char *socket_path){
+    struct sockaddr_un addr;
+    int fd;
+
+    if (!make_address(socket_path, &addr))
+        return -1;
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0){
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * Read the size of an inline source
+ *
+ * Args:
+ * s - The size, in decimal
+ * size - Where the size is written
+ *
+ * Return:
+ * False if the size is not a number or is bigger than SOURCE_MAX_SIZE
+ */
+static bool parse_source_size(char *s, unsigned long *size){
+    char *end;
+
+    /* strtoul would take a sign or leading whitespaces */
+    if (!isdigit((unsigned char) *s))
+        return false;
+
+    errno = 0;
+    *size = strtoul(s, &end, 10);
+    return errno == 0 && *end == '\0' && *size <= SOURCE_MAX_SIZE;
+}
+
+/*
+ * Read the header of a request
+ *
+ * Return:
+ * False if the header is malformed
+ */
+static bool read_request(Connection *conn, Request *req){
+    char line[HEADER_LINE_MAX_SIZE];
+
+    memset(req, 0, sizeof(Request));
+
+    while (read_line(conn, line)){
+        /* An empty line ends the header */
+        if (line[0] == '\0')
+            return req->shutdown || req->name[0] != '\0';
+
+        if (starts_with(line, "assemble "))
+            strcpy(req->name, line + 9);
+        else if (starts_with(line, "outdir "))
+            strcpy(req->outdir, line + 7);
+        else if (strcmp(line, "binary") == 0)
+            req->binary_output = true;
+        else if (starts_with(line, "source ")){
+            req->has_source = true;
+            if (!parse_source_size(line + 7, &req->source_size))
+                return false;
+        }
+        else if (strcmp(line, "shutdown") == 0)
+            req->shutdown = true;
+        else
+            return false;
+    }
+    return false;
+}
+
+/*
+ * Send a response
+ *
+ * Args:
+ * fd - The socket
+ * status - Status of the request
+ * out_basename - Base name of the outputs, NULL if there are none
+ * binary_output - True if the binary object file was written
+ * log - Messages of the assembling
+ * log_len - Length of <log>
+ */
+static void send_response(int fd, char *status, char *out_basename, bool binary_output, char *log, size_t log_len){
+    static char *suffixes[] = {".ob", ".ent", ".ext", BINARY_SUFFIX};
+    char *header;
+    size_t len;
+    int i, outputs_cnt;
+
+    outputs_cnt = out_basename == NULL ? 0 : binary_output ? 4 : 3;
+    header = (char *) malloc(64 + outputs_cnt * (strlen(out_basename ? out_basename : "") + 16));
+    if (header == NULL)
+        return;
+
+    len = sprintf(header, "status %s\n", status);
+    for (i = 0; i < outputs_cnt; i++)
+        len += sprintf(header + len, "output %s%s\n", out_basename, suffixes[i]);
+    len += sprintf(header + len, "log %lu\n\n", (unsigned long) log_len);
+
+    if (write_all(fd, header, len))
+        write_all(fd, log, log_len);
+    free(header);
+}
+
+/*
+ * Build the base name of the outputs of a request: the source file without its extension,
+ * moved to the output directory if there is one
+ *
+ * Return:
+ * The base name (to free), NULL if there is no memory
+ */
+static char *make_out_basename(Request *req){
+    char *basename, *stem, *ext;
+
+    stem = req->outdir[0] != '\0' && strrchr(req->name, '/') != NULL ? strrchr(req->name, '/') + 1 : req->name;
+    basename = (char *) malloc(strlen(req->outdir) + strlen(stem) + 2);
+    if (basename == NULL)
+        return NULL;
+
+    if (req->outdir[0] != '\0')
+        sprintf(basename, "%s/%s", req->outdir, stem);
+    else
+        strcpy(basename, stem);
+
+    /* Remove the extension of the file (not a dot of one of its directories) */
+    stem = strrchr(basename, '/') ? strrchr(basename, '/') + 1 : basename;
+    ext = strrchr(stem, '.');
+    if (ext != NULL && ext != stem)
+        *ext = '\0';
+
+    return basename;
+}
+
+/*
+ * Read, check and assemble the source file of a request
+ */
+static void assemble_request(Context *ctx){
+    char *content;
+
+    start_phase(&ctx->stats, READ_PHASE);
+    if (ctx->content != NULL){
+        /* The source file takes the content over */
+        content = ctx->content;
+        ctx->content = NULL;
+        ctx->src = read_source_buffer(ctx->fname, content, ctx->content_size);
+    }
+    else
+        ctx->src = read_source_file(ctx->fname);
+    ctx->stats.lines = ctx->src->lines_cnt;
+    end_phase(&ctx->stats, READ_PHASE);
+
+    ctx->is_valid = first_pass(ctx->src);
+    if (!ctx->is_valid)
+        return;
+
+    second_pass(ctx->src, ctx->labels, ctx->ic_size, ctx->dc_size);
+    free_source_file(ctx->src);
+    ctx->src = NULL;
+}
+
+/*
+ * Serve the request of a connection
+ *
+ * Args:
+ * worker - The worker serving the connection
+ * fd - The connected socket
+ */
+static void handle_connection(Worker *worker, int fd){
+    Connection conn;
+    Request req;
+    Context *ctx;
+    char *status, *out_basename;
+
+    conn.fd = fd;
+    conn.len = conn.pos = 0;
+
+    if (!read_request(&conn, &req)){
+        send_response(fd, "failed", NULL, false, "[x] Bad request\n", 16);
+        return;
+    }
+
+    if (req.shutdown){
+        send_response(fd, "ok", NULL, false, "", 0);
+        /* Wake up every worker waiting on the listening socket, they stop */
+        shutdown(worker->listen_fd, SHUT_RDWR);
+        return;
+    }
+
+    ctx = worker->ctx;
+    reset_context(ctx, req.name);
+    ctx->binary_output = req.binary_output;
+
+    out_basename = make_out_basename(&req);
+    if (out_basename == NULL){
+        send_response(fd, "failed", NULL, false, "[x] Out of memory\n", 18);
+        return;
+    }
+    ctx->out_basename = out_basename;
+
+    if (req.has_source){
+        ctx->content = (char *) malloc(req.source_size + 1);
+        ctx->content_size = req.source_size;
+        if (ctx->content == NULL || !read_exact(&conn, ctx->content, req.source_size)){
+            send_response(fd, "failed", NULL, false, "[x] Cannot receive the source\n", 30);
+            free(out_basename);
+            return;
+        }
+    }
+
+    run_in_context(ctx, assemble_request);
+
+    status = ctx->failed ? "failed" : !ctx->is_valid ? "invalid" : "ok";
+    send_response(fd, status, ctx->failed || !ctx->is_valid ? NULL : out_basename, ctx->binary_output,
+                  ctx->log, ctx->log_len);
+
+    printf("[*] %s: %s\n", req.name, status);
+    fflush(stdout);
+
+    /* The base name belongs to the request, the context keeps no pointer to it */
+    ctx->out_basename = NULL;
+    free(out_basename);
+}
+
+/*
+ * Worker loop: serve connections until the listening socket is shut down
+ */
+static void serve(void *arg){
+    Worker *worker = (Worker *) arg;
+    int fd;
+
+    while (1){
+        fd = accept(worker->listen_fd, NULL, NULL);
+        if (fd < 0){
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            break;
+        }
+
+        handle_connection(worker, fd);
+        close(fd);
+    }
+}
+
+bool run_server(char *socket_path, int workers_cnt){
+    struct sockaddr_un addr;
+    Worker *workers;
+    void **jobs;
+    int fd, i;
+
+    if (!make_address(socket_path, &addr))
+        return false;
+
+    /* A client that disconnects early must not kill the server */
+    signal(SIGPIPE, SIG_IGN);
+
+    /* Replace a stale socket, but never steal the socket of a running server */
+    fd = connect_to_server(socket_path);
+    if (fd >= 0){
+        close(fd);
+        printf("[x] A server is already running on %s\n", socket_path);
+        return false;
+    }
+    unlink(socket_path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(fd, LISTEN_BACKLOG) != 0){
+        printf("[x] Cannot listen on %s: %s\n", socket_path, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+
+    workers = (Worker *) calloc(workers_cnt, sizeof(Worker));
+    jobs = (void **) calloc(workers_cnt, sizeof(void *));
+    if (workers == NULL || jobs == NULL)
+        raise_error("Internal error: cannot create the workers.");
+
+    for (i = 0; i < workers_cnt; i++){
+        workers[i].listen_fd = fd;
+        workers[i].ctx = create_context("");
+        if (workers[i].ctx == NULL)
+            raise_error("Internal error: cannot create a context.");
+        jobs[i] = &workers[i];
+    }
+
+    printf("[*] Serving on %s with %d worker(s)\n", socket_path, workers_cnt);
+    fflush(stdout);
+
+    /* Every worker is a job that only returns once the server is shut down */
+    run_jobs(serve, jobs, workers_cnt, workers_cnt);
+
+    close(fd);
+    unlink(socket_path);
+
+    for (i = 0; i < workers_cnt; i++)
+        free_context(workers[i].ctx);
+    free(workers);
+    free(jobs);
+
+    printf("[v] Server stopped\n");
+    return true;
+}
+
+/*
+ * Write the absolute form of a path
+ *
+ * Args:
+ * path - The path
+ * buf - Buffer of HEADER_LINE_MAX_SIZE characters where the absolute path is written
+ *
+ * Return:
+ * False if the path is too long
+ */
+static bool absolute_path(char *path, char *buf){
+    size_t len;
+
+    if (path[0] == '/'){
+        if (strlen(path) >= HEADER_LINE_MAX_SIZE)
+            return false;
+        strcpy(buf, path);
+        return true;
+    }
+
+    if (getcwd(buf, HEADER_LINE_MAX_SIZE) == NULL)
+        return false;
+
+    len = strlen(buf);
+    if (len + strlen(path) + 2 > HEADER_LINE_MAX_SIZE)
+        return false;
+    sprintf(buf + len, "/%s", path);
+    return true;
+}
+
+/*
+ * Read a whole file in memory
+ *
+ * Args:
+ * fname - Name of the file
+ * size - Pointer where the size of the file is written
+ *
+ * Return:
+ * The content (to free), NULL if the file cannot be read
+ */
+static char *read_file(char *fname, size_t *size){
+    FILE *fp;
+    char *content, *new_content;
+    size_t cap, n;
+
+    fp = fopen(fname, "rb");
+    if (fp == NULL)
+        return NULL;
+
+    cap = IO_BUF_SIZE;
+    *size = 0;
+    content = (char *) malloc(cap);
+    while (content != NULL && (n = fread(content + *size, 1, cap - *size, fp)) > 0){
+        *size += n;
+        if (*size == cap){
+            cap *= 2;
+            new_content = (char *) realloc(content, cap);
+            if (new_content == NULL)
+                free(content);
+            content = new_content;
+        }
+    }
+    fclose(fp);
+    return content;
+}
+
+/*
+ * Read a response and print its messages and outputs
+ *
+ * Return:
+ * False if the file was not assembled
+ */
+static bool print_response(int fd){
+    Connection conn;
+    char line[HEADER_LINE_MAX_SIZE];
+    char status[HEADER_LINE_MAX_SIZE];
+    char *log;
+    unsigned long log_len;
+
+    conn.fd = fd;
+    conn.len = conn.pos = 0;
+    status[0] = '\0';
+
+    while (read_line(&conn, line) && line[0] != '\0'){
+        if (starts_with(line, "status "))
+            strcpy(status, line + 7);
+        else if (starts_with(line, "output "))
+            printf("[v] Output: %s\n", line + 7);
+        else if (starts_with(line, "log ")){
+            log_len = strtoul(line + 4, NULL, 10);
+            log = (char *) malloc(log_len + 1);
+            if (log == NULL)
+                return false;
+            if (read_line(&conn, line) && line[0] == '\0' && read_exact(&conn, log, log_len))
+                fwrite(log, 1, log_len, stdout);
+            free(log);
+            break;
+        }
+    }
+
+    if (status[0] == '\0'){
+        printf("[x] Bad response from the server\n");
+        return false;
+    }
+    return strcmp(status, "ok") == 0;
+}
+
+/*
+ * Send a file to a server and print the response
+ *
+ * Return:
+ * False if the file was not assembled
+ */
+static bool send_file(char *socket_path, char *fname, char *outdir, bool binary_output, bool inline_source){
+    char path[HEADER_LINE_MAX_SIZE];
+    char *header, *content;
+    size_t len, size;
+    int fd;
+    bool ok;
+
+    content = NULL;
+    size = 0;
+    if (inline_source && (content = read_file(fname, &size)) == NULL){
+        printf("[x] Bad file: %s\n", fname);
+        return false;
+    }
+
+    header = (char *) malloc(3 * HEADER_LINE_MAX_SIZE);
+    if (header == NULL || !absolute_path(fname, path)){
+        printf("[x] Bad file: %s\n", fname);
+        free(content);
+        free(header);
+        return false;
+    }
+
+    len = sprintf(header, "assemble %s\n", path);
+    if (outdir != NULL && absolute_path(outdir, path))
+        len += sprintf(header + len, "outdir %s\n", path);
+    if (binary_output)
+        len += sprintf(header + len, "binary\n");
+    if (inline_source)
+        len += sprintf(header + len, "source %lu\n", (unsigned long) size);
+    len += sprintf(header + len, "\n");
+
+    fd = connect_to_server(socket_path);
+    if (fd < 0){
+        printf("[x] Cannot connect to the server %s\n", socket_path);
+        free(content);
+        free(header);
+        return false;
+    }
+
+    ok = write_all(fd, header, len) && (content == NULL || write_all(fd, content, size));
+    ok = ok && print_response(fd);
+
+    close(fd);
+    free(content);
+    free(header);
+    return ok;
+}
+
+bool run_client(char *socket_path, char **fnames, int cnt, char *outdir, bool binary_output, bool inline_source){
+    int i;
+    bool ok;
+
+    ok = true;
+    for (i = 0; i < cnt; i++){
+        printf("[*] Processing file %s\n", fnames[i]);
+        if (!send_file(socket_path, fnames[i], outdir, binary_output, inline_source))
+            ok = false;
+    }
+    return ok;
+}
+
+bool stop_server(char *socket_path){
+    int fd;
+    bool ok;
+
+    fd = connect_to_server(socket_path);
+    if (fd < 0){
+        printf("[x] Cannot connect to the server %s\n", socket_path);
+        return false;
+    }
+
+    ok = write_all(fd, "shutdown\n\n", 10) && print_response(fd);
+    close(fd);
+    return ok;
+}
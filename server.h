@@ -0,0 +1,68 @@
+/*
+ * Persistent assembler server over a Unix socket (--server), and its client (--client)
+ *
+ * The server keeps its worker threads, their contexts and their arenas between requests, so a
+ * request only pays for the reading and the assembling of its source file.
+ * Each connection carries one request and its response, both made of text header lines
+ * ended by an empty line, and followed by an optional body.
+ *
+ * Request:
+ *   assemble <name>      Source file to assemble (a path as seen by the server, or the name of the inline source)
+ *   outdir <dir>         Optional, directory of the outputs (by default they are written next to the source file)
+ *   binary               Optional, write the binary object file too (see --binary)
+ *   source <size>        Optional, the source is not read from <name>: its <size> bytes follow the header
+ *                        (at most 1 GB, a bigger or malformed size fails the request)
+ * or:
+ *   shutdown             Stop the server once the running requests are done
+ *
+ * Response:
+ *   status <status>      ok, invalid (errors found in the source) or failed
+ *   output <path>        One line per written output file
+ *   log <size>           The messages of the assembling ("[x] ..." diagnostics) follow the header
+ */
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdbool.h>
+
+/*
+ * Serve assemble requests on a Unix socket until a shutdown request
+ * A stale socket file left by a previous server is replaced
+ *
+ * Args:
+ * socket_path - Path of the socket
+ * workers_cnt - Number of worker threads (requests assembled at the same time)
+ *
+ * Return:
+ * False if the socket cannot be created
+ */
+bool run_server(char *socket_path, int workers_cnt);
+
+/*
+ * Send the files to a server, then print the messages and the outputs of each file
+ *
+ * Args:
+ * socket_path - Path of the server socket
+ * fnames - The source files
+ * cnt - Number of files
+ * outdir - Directory of the outputs, NULL to write them next to each source file
+ * binary_output - True to write the binary object files too
+ * inline_source - True to send the content of the files, the server doesn't read them itself
+ *
+ * Return:
+ * False if any file could not be assembled
+ */
+bool run_client(char *socket_path, char **fnames, int cnt, char *outdir, bool binary_output, bool inline_source);
+
+/*
+ * Ask a server to stop
+ *
+ * Args:
+ * socket_path - Path of the server socket
+ *
+ * Return:
+ * False if the server cannot be reached
+ */
+bool stop_server(char *socket_path);
+
+#endif
@@ -0,0 +1,102 @@
+/*
+ * SHA-256 hash function (FIPS 180-4)
+ */
+#include <string.h>
+#include "sha256.h"
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static const uint32_t k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/*
+ * Hash one 64 bytes block
+ */
+static void sha256_block(Sha256 *sha, const unsigned char *p){
+    uint32_t w[64];
+    uint32_t a, b, c, d, e, f, g, h, t1, t2;
+    int i;
+
+    for (i = 0; i < 16; i++)
+        w[i] = ((uint32_t) p[4 * i] << 24) | ((uint32_t) p[4 * i + 1] << 16) | ((uint32_t) p[4 * i + 2] << 8) | p[4 * i + 3];
+    for (i = 16; i < 64; i++)
+        w[i] = (ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10)) + w[i - 7]
+             + (ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3)) + w[i - 16];
+
+    a = sha->h[0]; b = sha->h[1]; c = sha->h[2]; d = sha->h[3];
+    e = sha->h[4]; f = sha->h[5]; g = sha->h[6]; h = sha->h[7];
+
+    for (i = 0; i < 64; i++){
+        t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+        t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    sha->h[0] += a; sha->h[1] += b; sha->h[2] += c; sha->h[3] += d;
+    sha->h[4] += e; sha->h[5] += f; sha->h[6] += g; sha->h[7] += h;
+}
+
+void sha256_init(Sha256 *sha){
+    sha->h[0] = 0x6a09e667; sha->h[1] = 0xbb67ae85; sha->h[2] = 0x3c6ef372; sha->h[3] = 0xa54ff53a;
+    sha->h[4] = 0x510e527f; sha->h[5] = 0x9b05688c; sha->h[6] = 0x1f83d9ab; sha->h[7] = 0x5be0cd19;
+    sha->block_len = 0;
+    sha->total_len = 0;
+}
+
+void sha256_update(Sha256 *sha, const void *data, size_t len){
+    const unsigned char *p = (const unsigned char *) data;
+    size_t n;
+
+    sha->total_len += len;
+
+    /* Complete the waiting block first */
+    if (sha->block_len > 0){
+        n = 64 - sha->block_len < len ? 64 - sha->block_len : len;
+        memcpy(sha->block + sha->block_len, p, n);
+        sha->block_len += n;
+        p += n;
+        len -= n;
+        if (sha->block_len < 64)
+            return;
+        sha256_block(sha, sha->block);
+        sha->block_len = 0;
+    }
+
+    for (; len >= 64; p += 64, len -= 64)
+        sha256_block(sha, p);
+
+    memcpy(sha->block, p, len);
+    sha->block_len = len;
+}
+
+void sha256_final_hex(Sha256 *sha, char *hex){
+    static const char digits[] = "0123456789abcdef";
+    unsigned char pad[72];
+    unsigned long bits;
+    size_t pad_len;
+    int i;
+
+    /* 0x80, zeros up to 56 bytes modulo 64, then the length in bits (big endian) */
+    bits = sha->total_len * 8;
+    pad_len = sha->block_len < 56 ? 56 - sha->block_len : 120 - sha->block_len;
+    memset(pad, 0, sizeof(pad));
+    pad[0] = 0x80;
+    for (i = 0; i < 8; i++)
+        pad[pad_len + i] = i < 4 && sizeof(unsigned long) <= 4 ? 0 : (unsigned char) (bits >> (8 * (7 - i)));
+    sha256_update(sha, pad, pad_len + 8);
+
+    for (i = 0; i < SHA256_SIZE; i++){
+        hex[2 * i] = digits[(sha->h[i / 4] >> (24 - 8 * (i % 4))) >> 4 & 0xF];
+        hex[2 * i + 1] = digits[(sha->h[i / 4] >> (24 - 8 * (i % 4))) & 0xF];
+    }
+    hex[2 * SHA256_SIZE] = '\0';
+}
@@ -0,0 +1,56 @@
+/*
+ * SHA-256 hash function (FIPS 180-4), used to address the build cache
+ */
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_SIZE 32
+#define SHA256_HEX_SIZE (2 * SHA256_SIZE + 1)
+
+/*
+ * State of a running hash
+ *
+ * Attributes:
+ * h - Intermediate hash value
+ * block - Bytes waiting for a full 64 bytes block
+ * block_len - Number of bytes in <block>
+ * total_len - Number of bytes hashed so far
+ */
+typedef struct Sha256{
+	uint32_t h[8];
+	unsigned char block[64];
+	size_t block_len;
+	unsigned long total_len;
+} Sha256;
+
+/*
+ * Start a hash
+ *
+ * Args:
+ * sha - State of the hash
+ */
+void sha256_init(Sha256 *sha);
+
+/*
+ * Add bytes to a hash
+ *
+ * Args:
+ * sha - State of the hash
+ * data - The bytes
+ * len - Number of bytes
+ */
+void sha256_update(Sha256 *sha, const void *data, size_t len);
+
+/*
+ * Finish a hash and write it in hexadecimal
+ *
+ * Args:
+ * sha - State of the hash
+ * hex - Where the hash is written (SHA256_HEX_SIZE characters, null terminated)
+ */
+void sha256_final_hex(Sha256 *sha, char *hex);
+
+#endif
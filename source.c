@@ -0,0 +1,221 @@
+/*
+ * In-memory representation of a source file
+ * The file is mapped in memory and each line is lexed once
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "errors.h"
+#include "globals.h"
+#include "utils.h"
+#include "source.h"
+#include "lexer.h"
+#include "scanner.h"
+#include "context.h"
+
+#define READ_CHUNK_SIZE 65536
+
+/*
+ * Read the whole content of a stream
+ *
+ * Args:
+ * fp - Stream to read
+ * size - Pointer where the number of read characters is written
+ *
+ * Return:
+ * Buffer holding the content of the stream
+ */
+static char *read_all(FILE *fp, size_t *size){
+    char *buf;
+    size_t cap, cnt, n;
+
+    cap = READ_CHUNK_SIZE;
+    cnt = 0;
+    buf = (char *) malloc(cap);
+
+    while (buf != NULL && (n = fread(buf + cnt, 1, cap - cnt, fp)) > 0){
+        cnt += n;
+        if (cnt == cap){
+            cap *= 2;
+            buf = (char *) realloc(buf, cap);
+        }
+    }
+
+    if (buf == NULL)
+        raise_error("Internal error: cannot read the source file.");
+
+    *size = cnt;
+    return buf;
+}
+
+/*
+ * Copy a line, keeping only the first whitespace (as a space) of every sequence of whitespaces
+ *
+ * Args:
+ * src - Beginning of the line
+ * len - Length of the line (without the line break)
+ * dst - Buffer where the line is written
+ *
+ * Return:
+ * Number of characters written in <dst>
+ */
+static int collapse_spaces(char *src, size_t len, char *dst){
+    size_t i;
+    int count, space_seen;
+
+    count = space_seen = 0;
+    for (i = 0; i < len; i++){
+        if (isspace((unsigned char) src[i])){
+            /* If a space has already been seen, ignore this one */
+            if (space_seen)
+                continue;
+            space_seen = 1;
+            dst[count++] = WHITESPACE;
+        }
+        else{
+            space_seen = 0;
+            dst[count++] = src[i];
+        }
+    }
+    dst[count] = '\0';
+    return count;
+}
+
+/*
+ * Map a file in memory
+ *
+ * Args:
+ * fd - Descriptor of the file
+ * size - Pointer where the size of the file is written
+ *
+ * Return:
+ * The mapped content, NULL if the file cannot be mapped (not a regular file, empty...)
+ */
+static char *map_file(int fd, size_t *size){
+    struct stat st;
+    void *content;
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+        return NULL;
+
+    content = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (content == MAP_FAILED)
+        return NULL;
+
+    *size = st.st_size;
+    return (char *) content;
+}
+
+/*
+ * Split the content of a source file into lines and lex each of them
+ *
+ * Args:
+ * src - The source file, its content must already be set
+ */
+static void parse_source(SourceFile *src){
+    int lines_cnt;
+    SourceLine *line;
+    Token *operands;
+    Lexer lx;
+
+    /* Split the file into line views, and find the irrelevant lines */
+    src->lines = scan_lines(src->content, src->size, &src->lines_cnt);
+    lines_cnt = src->lines_cnt;
+
+    /* The strings of a line take at most its characters, plus a terminator per string */
+    src->pool = (char *) malloc(2 * (src->size + 2 * lines_cnt));
+    if (src->pool == NULL)
+        raise_error("Internal error: cannot read the source file.");
+
+    init_lexer(&lx, src->pool);
+    for (line = src->lines; line < src->lines + src->lines_cnt; line++)
+        lex_line(&lx, line);
+    src->tokens = lx.tokens;
+
+    /* The tokens won't move anymore, the operands of each line follow the ones of the previous line */
+    operands = src->tokens;
+    for (line = src->lines; line < src->lines + src->lines_cnt; line++){
+        line->operands = operands;
+        operands += line->operands_cnt;
+    }
+}
+
+SourceFile *read_source_file(char *fname){
+    SourceFile *src;
+    FILE *fp;
+
+    fp = ctx_fopen(fname, "r");
+    if (fp == NULL){
+        report("[x] Bad file: %s\n", fname);
+        raise_error(NULL);
+    }
+
+    src = (SourceFile *) calloc(1, sizeof(SourceFile));
+    src->fname = fname;
+
+    /* Map the file, or read it if it cannot be mapped */
+    src->content = map_file(fileno(fp), &src->size);
+    src->is_mapped = src->content != NULL;
+    if (!src->is_mapped)
+        src->content = read_all(fp, &src->size);
+    fclose(fp);
+
+    parse_source(src);
+    return src;
+}
+
+SourceFile *read_source_buffer(char *fname, char *content, size_t size){
+    SourceFile *src;
+
+    src = (SourceFile *) calloc(1, sizeof(SourceFile));
+    src->fname = fname;
+    src->content = content;
+    src->size = size;
+    src->is_mapped = false;
+
+    parse_source(src);
+    return src;
+}
+
+SourceFile *read_source_window(char *fname, char *content, size_t size, int first_line_no){
+    SourceFile *src;
+    int i;
+
+    src = (SourceFile *) calloc(1, sizeof(SourceFile));
+    src->fname = fname;
+    src->content = content;
+    src->size = size;
+    src->is_window = true;
+
+    parse_source(src);
+    for (i = 0; i < src->lines_cnt; i++)
+        src->lines[i].line_no += first_line_no - 1;
+    return src;
+}
+
+char *get_raw_line(SourceLine *line, char *buf){
+    collapse_spaces(line->start, line->len, buf);
+    return buf;
+}
+
+void free_source_file(SourceFile *src){
+    if (src == NULL)
+        return;
+
+    if (src->is_mapped)
+        munmap(src->content, src->size);
+    else if (!src->is_window)
+        free(src->content);
+
+    free(src->lines);
+    free(src->tokens);
+    free(src->pool);
+    free(src);
+}
@@ -0,0 +1,173 @@
+/*
+ * In-memory representation of a source file
+ * The file is mapped in memory and lexed once (see lexer.h), every pass then works on the tokens of the lines
+ */
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "instructions.h"
+
+#define MNEMONIC_MAX_SIZE 8
+
+/*
+ * Kinds of lines - every line of a source file is exactly one of them
+ */
+typedef enum {
+	IRRELEVANT_LINE,
+	CODE_LINE,
+	DATA_LINE,
+	ENTRY_LINE,
+	EXTERNAL_LINE
+} LineKind;
+
+/*
+ * Kinds of operands, given by their first character
+ */
+typedef enum {
+	REGISTER_TOKEN, /* $ */
+	IMMEDIATE_TOKEN, /* Digit or sign */
+	STRING_TOKEN, /* Double quote */
+	LABEL_TOKEN /* Anything else */
+} TokenKind;
+
+/*
+ * Represent an operand of a line
+ *
+ * Attributes:
+ * kind - Kind of the operand
+ * text - The operand without its whitespaces (for a string, the characters between the quotes)
+ * len - Length of <text>
+ * value - Number of a register, value of an immediate (as atoi reads it), 0 for the other kinds
+ */
+typedef struct Token{
+	TokenKind kind;
+	char *text;
+	int len;
+	int value;
+} Token;
+
+/*
+ * Represent a parsed line of a source file
+ *
+ * Attributes:
+ * start - Beginning of the line in the file content (not null terminated)
+ * len - Length of the line in the file content, without the line break
+ * label - Label defined on the line, NULL if there is none ("" if the colon has no name)
+ * mnemonic - Command or directive name of the line (truncated if it is too long)
+ * instr - Description of the command of a code line, NULL if the command doesn't exist
+ * directive - Description of the directive of a data, entry or external line
+ * operands - Operands of the line, in order (empty ones are skipped)
+ * operands_cnt - Number of operands
+ * double_comma - True if two commas follow each other with no operand in between
+ * open_quote - True if the line has an odd number of double quotes
+ * line_no - Number of the line in the source file (starting from 1)
+ * flags - What the scanner found in the line, before it was lexed (see scanner.h)
+ * raw_len - Length of the line once consecutive whitespaces are collapsed (0 for irrelevant lines)
+ * kind - Kind of the line
+ */
+typedef struct SourceLine{
+	char *start;
+	int len;
+	char *label;
+	char mnemonic[MNEMONIC_MAX_SIZE];
+	const Instruction *instr;
+	const Directive *directive;
+	Token *operands;
+	int operands_cnt;
+	bool double_comma;
+	bool open_quote;
+	int line_no;
+	int flags;
+	int raw_len;
+	LineKind kind;
+} SourceLine;
+
+/*
+ * Represent a source file
+ *
+ * Attributes:
+ * fname - Name of the file
+ * content - Content of the file (mapped in memory when possible)
+ * size - Size of <content>
+ * is_mapped - True if <content> is a memory mapping, false if it was read into a buffer
+ * is_window - True if <content> is the window of a stream (see stream.h), it belongs to the stream
+ * lines - Parsed lines, in file order
+ * lines_cnt - Number of lines
+ * tokens - Operands of every line, the operands of a line follow each other
+ * pool - Memory holding the strings of the relevant lines
+ */
+typedef struct SourceFile{
+	char *fname;
+	char *content;
+	size_t size;
+	bool is_mapped;
+	bool is_window;
+	SourceLine *lines;
+	int lines_cnt;
+	Token *tokens;
+	char *pool;
+} SourceFile;
+
+/*
+ * Map a whole file in memory and lex each of its lines
+ * Irrelevant lines (empty or commented out) are found by the scanner and never lexed
+ * An error is raised if the file cannot be read
+ *
+ * Args:
+ * fname - Name of the file to read
+ *
+ * Return:
+ * The parsed file
+ */
+SourceFile *read_source_file(char *fname);
+
+/*
+ * Lex a source file that is already in memory
+ *
+ * Args:
+ * fname - Name of the source file (used for the outputs and the messages)
+ * content - Content of the file, allocated with malloc, the source file takes it over
+ * size - Size of <content>
+ *
+ * Return:
+ * The parsed file
+ */
+SourceFile *read_source_buffer(char *fname, char *content, size_t size);
+
+/*
+ * Lex a window of whole lines of a source file (see stream.h)
+ *
+ * Args:
+ * fname - Name of the source file (used for the outputs and the messages)
+ * content - The lines, they are not copied and must outlive the parsed lines
+ * size - Size of <content>
+ * first_line_no - Number of the first line of the window in the file
+ *
+ * Return:
+ * The parsed lines, <content> is not freed with them
+ */
+SourceFile *read_source_window(char *fname, char *content, size_t size, int first_line_no);
+
+/*
+ * Write a line as read, with consecutive whitespaces collapsed (used for diagnostics)
+ *
+ * Args:
+ * line - The line
+ * buf - Buffer where the line is written (at least <line->len> + 1 characters)
+ *
+ * Return:
+ * <buf>
+ */
+char *get_raw_line(SourceLine *line, char *buf);
+
+/*
+ * Free a source file and all its lines
+ *
+ * Args:
+ * src - The source file to free
+ */
+void free_source_file(SourceFile *src);
+
+#endif
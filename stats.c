@@ -0,0 +1,126 @@
+/*
+ * Per-file statistics of the assembling (--stats)
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <time.h>
+#include "stats.h"
+
+/*
+ * Names of the phases, as printed
+ */
+static char *phases_names[PHASES_CNT] = {
+    "read",
+    "first_pass",
+    "second_pass"
+};
+
+/*
+ * Read a clock, in seconds
+ */
+static double read_clock(clockid_t clock){
+    struct timespec ts;
+
+    if (clock_gettime(clock, &ts) != 0)
+        return 0;
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+double get_wall_time(){
+    return read_clock(CLOCK_MONOTONIC);
+}
+
+double get_thread_cpu_time(){
+    return read_clock(CLOCK_THREAD_CPUTIME_ID);
+}
+
+double get_process_cpu_time(){
+    return read_clock(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+void start_phase(Stats *stats, Phase phase){
+    if (stats == NULL)
+        return;
+
+    stats->wall_start = get_wall_time();
+    stats->cpu_start = get_thread_cpu_time();
+}
+
+void end_phase(Stats *stats, Phase phase){
+    if (stats == NULL)
+        return;
+
+    stats->wall[phase] += get_wall_time() - stats->wall_start;
+    stats->cpu[phase] += get_thread_cpu_time() - stats->cpu_start;
+}
+
+void add_stats(Stats *total, Stats *stats){
+    int i;
+
+    for (i = 0; i < PHASES_CNT; i++){
+        total->wall[i] += stats->wall[i];
+        total->cpu[i] += stats->cpu[i];
+    }
+
+    total->lines += stats->lines;
+    total->code_words += stats->code_words;
+    total->data_bytes += stats->data_bytes;
+    total->labels += stats->labels;
+    total->externs += stats->externs;
+    total->entries += stats->entries;
+    total->ob_bytes += stats->ob_bytes;
+    total->ent_bytes += stats->ent_bytes;
+    total->ext_bytes += stats->ext_bytes;
+    total->bin_bytes += stats->bin_bytes;
+    total->file_opens += stats->file_opens;
+}
+
+void print_stats(FILE *fp, char *title, Stats *stats){
+    int i;
+
+    fprintf(fp, "[stats] %s\n", title);
+    for (i = 0; i < PHASES_CNT; i++)
+        fprintf(fp, "    %-12s wall %.6f s, cpu %.6f s\n", phases_names[i], stats->wall[i], stats->cpu[i]);
+
+    fprintf(fp, "    lines: %ld, code words: %ld, data bytes: %ld\n", stats->lines, stats->code_words, stats->data_bytes);
+    fprintf(fp, "    labels: %ld, externals: %ld, entries: %ld\n", stats->labels, stats->externs, stats->entries);
+    fprintf(fp, "    bytes written: .ob %ld, .ent %ld, .ext %ld, .bin %ld\n", stats->ob_bytes, stats->ent_bytes, stats->ext_bytes, stats->bin_bytes);
+    fprintf(fp, "    file opens: %ld\n", stats->file_opens);
+}
+
+/*
+ * Print a string as a JSON string (quoted and escaped)
+ */
+static void print_json_string(FILE *fp, char *s){
+    fputc('"', fp);
+    for (; *s; s++){
+        if (*s == '"' || *s == '\\')
+            fprintf(fp, "\\%c", *s);
+        else if ((unsigned char) *s < 0x20)
+            fprintf(fp, "\\u%04x", (unsigned char) *s);
+        else
+            fputc(*s, fp);
+    }
+    fputc('"', fp);
+}
+
+void print_stats_json(FILE *fp, char *fname, bool failed, Stats *stats){
+    int i;
+
+    fprintf(fp, "{");
+    if (fname != NULL){
+        fprintf(fp, "\"file\": ");
+        print_json_string(fp, fname);
+        fprintf(fp, ", ");
+    }
+    fprintf(fp, "\"failed\": %s, \"phases\": {", failed ? "true" : "false");
+    for (i = 0; i < PHASES_CNT; i++)
+        fprintf(fp, "%s\"%s\": {\"wall\": %.6f, \"cpu\": %.6f}", i > 0 ? ", " : "", phases_names[i], stats->wall[i], stats->cpu[i]);
+
+    fprintf(fp, "}, \"lines\": %ld, \"code_words\": %ld, \"data_bytes\": %ld", stats->lines, stats->code_words, stats->data_bytes);
+    fprintf(fp, ", \"labels\": %ld, \"externs\": %ld, \"entries\": %ld", stats->labels, stats->externs, stats->entries);
+    fprintf(fp, ", \"bytes_written\": {\"ob\": %ld, \"ent\": %ld, \"ext\": %ld, \"bin\": %ld}",
+            stats->ob_bytes, stats->ent_bytes, stats->ext_bytes, stats->bin_bytes);
+    fprintf(fp, ", \"file_opens\": %ld}", stats->file_opens);
+}
@@ -0,0 +1,122 @@
+/*
+ * Per-file statistics of the assembling (--stats)
+ * Time spent in each phase and counters of what was read and written
+ */
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/*
+ * Phases of the assembling of a file
+ */
+typedef enum {
+	READ_PHASE,
+	FIRST_PASS_PHASE, /* Checking and labelling, in one scan */
+	SECOND_PASS_PHASE,
+	PHASES_CNT
+} Phase;
+
+/*
+ * Statistics of the assembling of a file (or of several files once added together)
+ *
+ * Attributes:
+ * wall - Wall time of each phase (seconds)
+ * cpu - CPU time of each phase, on the thread that ran it (seconds)
+ * wall_start - Wall clock when the running phase started
+ * cpu_start - CPU clock when the running phase started
+ * lines - Number of lines read
+ * code_words - Number of encoded instructions
+ * data_bytes - Number of encoded data bytes
+ * labels - Number of labels (including the external ones)
+ * externs - Number of external labels
+ * entries - Number of entry labels
+ * ob_bytes - Size of the object file
+ * ent_bytes - Size of the entries file
+ * ext_bytes - Size of the externals file
+ * bin_bytes - Size of the binary object file (0 without --binary)
+ * file_opens - Number of files opened
+ */
+typedef struct Stats{
+	double wall[PHASES_CNT];
+	double cpu[PHASES_CNT];
+	double wall_start;
+	double cpu_start;
+	long lines;
+	long code_words;
+	long data_bytes;
+	long labels;
+	long externs;
+	long entries;
+	long ob_bytes;
+	long ent_bytes;
+	long ext_bytes;
+	long bin_bytes;
+	long file_opens;
+} Stats;
+
+/*
+ * Return the wall clock, in seconds
+ */
+double get_wall_time();
+
+/*
+ * Return the CPU time used by the calling thread, in seconds
+ */
+double get_thread_cpu_time();
+
+/*
+ * Return the CPU time used by the whole process, in seconds
+ */
+double get_process_cpu_time();
+
+/*
+ * Start timing a phase
+ *
+ * Args:
+ * stats - Statistics of the file (nothing is done if NULL)
+ * phase - The phase
+ */
+void start_phase(Stats *stats, Phase phase);
+
+/*
+ * Stop timing a phase and add its duration to the statistics
+ *
+ * Args:
+ * stats - Statistics of the file (nothing is done if NULL)
+ * phase - The phase, started by start_phase
+ */
+void end_phase(Stats *stats, Phase phase);
+
+/*
+ * Add statistics to a total
+ *
+ * Args:
+ * total - The total
+ * stats - The statistics to add
+ */
+void add_stats(Stats *total, Stats *stats);
+
+/*
+ * Print statistics as text
+ *
+ * Args:
+ * fp - Output stream
+ * title - Title of the statistics (file name, or "total")
+ * stats - The statistics
+ */
+void print_stats(FILE *fp, char *title, Stats *stats);
+
+/*
+ * Print statistics as a JSON object
+ *
+ * Args:
+ * fp - Output stream
+ * fname - Name of the file, NULL to omit the "file" member
+ * failed - True if the file failed, written as the "failed" member
+ * stats - The statistics
+ */
+void print_stats_json(FILE *fp, char *fname, bool failed, Stats *stats);
+
+#endif
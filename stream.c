@@ -0,0 +1,124 @@
+/*
+ * Streaming of the source files, through a window of whole lines
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "errors.h"
+#include "context.h"
+#include "stream.h"
+
+SourceStream *open_source_stream(char *fname){
+    SourceStream *st;
+    Context *ctx;
+    FILE *fp;
+
+    fp = ctx_fopen(fname, "r");
+    if (fp == NULL){
+        report("[x] Bad file: %s\n", fname);
+        raise_error(NULL);
+    }
+
+    st = (SourceStream *) calloc(1, sizeof(SourceStream));
+    if (st != NULL){
+        st->size = STREAM_WINDOW_SIZE;
+        st->window = (char *) malloc(st->size);
+    }
+    if (st == NULL || st->window == NULL){
+        free(st);
+        fclose(fp);
+        raise_error("Internal error: cannot read the source file.");
+    }
+    st->fname = fname;
+    st->fp = fp;
+
+    /* The stream reads big blocks already */
+    setvbuf(fp, NULL, _IONBF, 0);
+
+    ctx = get_current_context();
+    if (ctx != NULL)
+        ctx->stream = st;
+
+    return st;
+}
+
+/*
+ * Fill the free part of the window of a stream, up to the end of the file
+ */
+static void fill_window(SourceStream *st){
+    size_t n;
+
+    while (!st->eof && st->len < st->size){
+        n = fread(st->window + st->len, 1, st->size - st->len, st->fp);
+        if (n == 0){
+            if (ferror(st->fp))
+                raise_error("Internal error: cannot read the source file.");
+            st->eof = true;
+        }
+        st->len += n;
+    }
+}
+
+/*
+ * Number of characters of a stream window up to (and with) its last line break, 0 if it has none
+ */
+static size_t whole_lines_len(SourceStream *st){
+    size_t len;
+
+    for (len = st->len; len > 0 && st->window[len - 1] != '\n'; len--) {}
+    return len;
+}
+
+SourceFile *next_source_window(SourceStream *st){
+    char *new_window;
+    size_t batch_len;
+
+    /* Drop the lines of the previous window, keep what was read after them */
+    if (st->batch != NULL){
+        batch_len = st->batch->size;
+        free_source_file(st->batch);
+        st->batch = NULL;
+
+        memmove(st->window, st->window + batch_len, st->len - batch_len);
+        st->len -= batch_len;
+    }
+
+    for (;;){
+        fill_window(st);
+
+        /* The last line of the file may have no line break */
+        batch_len = st->eof ? st->len : whole_lines_len(st);
+        if (batch_len > 0 || st->eof)
+            break;
+
+        /* A line longer than the window, grow it until the line fits */
+        new_window = (char *) realloc(st->window, 2 * st->size);
+        if (new_window == NULL)
+            raise_error("Internal error: cannot read the source file.");
+        st->window = new_window;
+        st->size *= 2;
+    }
+
+    if (batch_len == 0)
+        return NULL;
+
+    st->batch = read_source_window(st->fname, st->window, batch_len, st->lines_cnt + 1);
+    st->lines_cnt += st->batch->lines_cnt;
+    return st->batch;
+}
+
+void close_source_stream(SourceStream *st){
+    Context *ctx;
+
+    if (st == NULL)
+        return;
+
+    ctx = get_current_context();
+    if (ctx != NULL && ctx->stream == st)
+        ctx->stream = NULL;
+
+    free_source_file(st->batch);
+    fclose(st->fp);
+    free(st->window);
+    free(st);
+}
@@ -0,0 +1,74 @@
+/*
+ * Streaming of the source files (see --stream)
+ * A file is read through a window of whole lines: each window is lexed on its own and freed before
+ * the next one is read, so the memory taken by a file doesn't grow with its number of lines.
+ * A stream is kept in the current context while it is open, so that an error stopping the pass closes it.
+ */
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "source.h"
+
+/* Number of characters read at once, the window only grows for a line longer than that */
+#define STREAM_WINDOW_SIZE 1048576
+
+/*
+ * Represent a source file read through a window
+ *
+ * Attributes:
+ * fname - Name of the source file
+ * fp - The source file
+ * window - Characters read from the file, starting with the lines of the current window
+ * len - Number of characters in <window>
+ * size - Number of allocated characters in <window>
+ * eof - True once the end of the file is read
+ * batch - The lexed lines of the current window, NULL if there is none
+ * lines_cnt - Number of lines read so far (the whole file once the stream is over)
+ */
+typedef struct SourceStream{
+	char *fname;
+	FILE *fp;
+	char *window;
+	size_t len;
+	size_t size;
+	bool eof;
+	SourceFile *batch;
+	int lines_cnt;
+} SourceStream;
+
+/*
+ * Open a source file for streaming
+ * An error is raised if the file cannot be read
+ *
+ * Args:
+ * fname - Name of the file
+ *
+ * Return:
+ * The stream (close it with close_source_stream)
+ */
+SourceStream *open_source_stream(char *fname);
+
+/*
+ * Read and lex the next window of lines, the lines of the previous window are freed
+ * The lines are numbered as in the whole file
+ *
+ * Args:
+ * st - The stream
+ *
+ * Return:
+ * The lines of the window, NULL once the whole file is read
+ */
+SourceFile *next_source_window(SourceStream *st);
+
+/*
+ * Close a stream and free its window
+ *
+ * Args:
+ * st - The stream, nothing is done if NULL
+ */
+void close_source_stream(SourceStream *st);
+
+#endif
@@ -0,0 +1,108 @@
+/*
+ * Tests of the embeddable assembler (libassembler.a)
+ * Each case assembles a source held in memory and checks the status and the diagnostics of the result
+ *
+ * Usage: test_libassembler
+ */
+#include <stdio.h>
+#include <string.h>
+#include "libassembler.h"
+
+/*
+ * Represent a test case
+ *
+ * Attributes:
+ * name - Name of the case
+ * src - The source to assemble
+ * status - Expected status
+ * code_size - Expected size of the code, only checked when the status is ASM_OK
+ * diagnostic - Text expected in one of the diagnostics, NULL if none is expected
+ * line_no - Line number expected in that diagnostic
+ */
+typedef struct TestCase{
+	char *name;
+	char *src;
+	AsmStatus status;
+	size_t code_size;
+	char *diagnostic;
+	int line_no;
+} TestCase;
+
+/* Enough lines between a branch and its label for the distance to overflow the immediate field */
+#define FAR_BRANCH_LINES 8192
+
+static char far_branch_src[FAR_BRANCH_LINES * 5 + 32];
+
+static TestCase cases[] = {
+    {"valid source", "MAIN: add $1,$2,$3\nbne $1,$2,MAIN\nstop\n", ASM_OK, 12, NULL, 0},
+    {"undefined branch label", "stop\nbne $1,$2,NOPE\n", ASM_FAILED, 0, "label NOPE doesn't exist", 2},
+    {"undefined jump label", "jmp NOPE\n", ASM_FAILED, 0, "label NOPE doesn't exist", 1},
+    {"undefined entry", "stop\n.entry NOPE\n", ASM_FAILED, 0, "entry NOPE doesn't match any label", 2},
+    {"unknown command", "foo $1\n", ASM_INVALID, 0, "Command <foo> doesn't exist", 1},
+    {"line starting with a comma", ", $1\n", ASM_INVALID, 0, "Command <,> doesn't exist", 1},
+    {"immediate out of range", "stop\nsw $1,99999,$3\n", ASM_INVALID, 0, "doesn't fit in the immediate field", 2},
+    {"branch too far", far_branch_src, ASM_FAILED, 0, "label FAR is too far to branch to", 1}
+};
+
+/*
+ * Build the source of the "branch too far" case
+ */
+static void build_far_branch_src(){
+    char *p;
+    int i;
+
+    p = far_branch_src;
+    p += sprintf(p, "beq $1,$2,FAR\n");
+    for (i = 0; i < FAR_BRANCH_LINES; i++)
+        p += sprintf(p, "stop\n");
+    sprintf(p, "FAR: stop\n");
+}
+
+/*
+ * Check if one of the diagnostics of a result holds a text, on the given line
+ */
+static int has_diagnostic(AsmResult *result, char *text, int line_no){
+    int i;
+
+    for (i = 0; i < result->diagnostics_cnt; i++)
+        if (strstr(result->diagnostics[i].message, text) != NULL)
+            return result->diagnostics[i].line_no == line_no;
+    return 0;
+}
+
+/*
+ * Run a test case
+ *
+ * Return:
+ * 1 if the case passed
+ */
+static int run_case(TestCase *tc){
+    AsmResult result;
+    int passed;
+
+    assemble_buffer(tc->src, strlen(tc->src), NULL, &result);
+
+    passed = result.status == tc->status;
+    if (passed && tc->status == ASM_OK)
+        passed = result.code_size == tc->code_size;
+    if (passed && tc->diagnostic != NULL)
+        passed = has_diagnostic(&result, tc->diagnostic, tc->line_no);
+
+    printf("%s: %s\n", passed ? "ok" : "FAIL", tc->name);
+    free_asm_result(&result);
+    return passed;
+}
+
+int main(){
+    int i, failed;
+
+    build_far_branch_src();
+
+    failed = 0;
+    for (i = 0; i < (int) (sizeof(cases) / sizeof(cases[0])); i++)
+        if (!run_case(&cases[i]))
+            failed++;
+
+    printf("%d failed\n", failed);
+    return failed > 0;
+}
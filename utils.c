@@ -8,6 +8,8 @@
 #include <ctype.h>
 #include <stdio.h>
 #include "globals.h"
+#include "utils.h"
+#include "context.h"
 
 int get_line_wout_spaces(char **buffer, size_t *size, FILE *file){
     int    c;
@@ -53,77 +55,63 @@ int get_line_wout_spaces(char **buffer, size_t *size, FILE *file){
 }
 
 char *get_basename(char *fname){
-    return strtok(fname, ".");
-}
-
-char *trim_whitespaces(char *s){
-    while (*s == WHITESPACE)
-        s++;
-    return s;
-}
+    char *basename, *ext, *dir;
 
-char *clean_str(char *s){
-    int i, j;
-    char *clean_s; /* Hold the new and clean string */
-    int first_whitespace = 1; /* Flag - true if no whitespace have been seen yet */
+    basename = (char *) ctx_calloc(strlen(fname) + 1, sizeof(char));
+    strcpy(basename, fname);
 
-    clean_s = (char *) calloc(LINE_MAX_SIZE, sizeof(char));
-
-    /* Remove trailing whitespaces */
-    s = trim_whitespaces(s);
-
-    i = j = 0;
-
-	/* If the string contain a label, remove every whitespace until the operation name */
-	if ( strchr(s, ':') != NULL){
-		/* Go to the colon and ignore every whitespace */
-		while(s[i] != ':'){
-			if (s[i] != ' ')
-				clean_s[j++] = s[i];
-			i++;
-		}
-		clean_s[j++] = s[i++]; /* Add the colon */
-		/* Remove every whitespace until the operation */
-		while (isspace(s[i])){
-			i++;
-		}
-	}
+    /* Remove the extension of the file (not a dot of one of its directories) */
+    dir = strrchr(basename, '/');
+    ext = strrchr(dir ? dir : basename, '.');
+    if (ext != NULL && ext != (dir ? dir + 1 : basename))
+        *ext = '\0';
 
-    /* Remove extra whitespaces (keep only the first one) and linebreak */
-    while (s[i]){
+    return basename;
+}
 
-		/* If the char is a double quote, add everything until the corresponding quote */
-		if (s[i] == '"'){
+long get_file_size(char *fname){
+    FILE *fp;
+    long size;
 
-			clean_s[j++] = s[i++]; /* Add the first quote */
+    fp = fopen(fname, "r");
+    if (fp == NULL)
+        return -1;
 
-			while (s[i] != '"')
-				clean_s[j++] = s[i++]; /* Add the text in between */
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fclose(fp);
+    return size;
+}
 
-			clean_s[j++] = s[i++]; /* Add the second quote */
-		}
+char *next_token(char *s, char *delim, char **save_ptr){
+    char *end;
 
-        /* If the char is a whitespace:
-         * if it's the first one then add it, else ignore it */
-        if (s[i] == ' '){
-            if ( first_whitespace ){
-                first_whitespace = 0;
-                clean_s[j++] = s[i];
-            }
-            i++;
-        }
+    if (s == NULL)
+        s = *save_ptr;
 
-        /* If the char is a linebreak, don't add it */
-        else if (s[i] == '\n')
-            break;
+    /* Skip the delimiters before the token */
+    s += strspn(s, delim);
+    if (*s == '\0'){
+        *save_ptr = s;
+        return NULL;
+    }
 
-        /* If the char is a wanted char, simply add it */
-        else
-            clean_s[j++] = s[i++];
+    /* Cut the string at the end of the token */
+    end = s + strcspn(s, delim);
+    if (*end == '\0')
+        *save_ptr = end;
+    else{
+        *end = '\0';
+        *save_ptr = end + 1;
     }
 
-    clean_s[j] = '\0';
-    return clean_s;
+    return s;
+}
+
+char *trim_whitespaces(char *s){
+    while (*s == WHITESPACE)
+        s++;
+    return s;
 }
 
 bool starts_with(char *s, char *t){
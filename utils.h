@@ -27,13 +27,39 @@ int get_line_wout_spaces(char **buffer, size_t *size, FILE *file);
  * of the file without extension
  *
  * Args:
- * filename - Name of the file
+ * filename - Name of the file (not modified)
  *
  * Return:
- * Corresponding basename
+ * Corresponding basename (allocated with ctx_calloc)
  */
 char *get_basename(char *filename);
 
+/*
+ * Return the size of a file
+ *
+ * Args:
+ * fname - Name of the file
+ *
+ * Return:
+ * Size of the file in bytes, -1 if it cannot be opened
+ */
+long get_file_size(char *fname);
+
+/*
+ * Reentrant version of strtok: split a string into tokens
+ * The state is kept in <save_ptr> instead of a static variable,
+ * so it can be used by several threads at the same time
+ *
+ * Args:
+ * s - String to split on the first call, NULL on the next calls
+ * delim - Delimiter characters
+ * save_ptr - Where the position in the string is kept between calls
+ *
+ * Return:
+ * The next token, or NULL if there are no more tokens
+ */
+char *next_token(char *s, char *delim, char **save_ptr);
+
 /*
  * Remove every whitespace at the beggining of a string
  *
@@ -57,25 +83,6 @@ char *trim_whitespaces(char *s);
  */
 bool starts_with(char *s, char *t);
 
-/*
- * Clean a string, remove every unwanted character.
- * Remove trailing whitespaces
- * Remove unwanted characters
- * Remove consecutive whitespaces
- *
- * After the clean there will be:
- * - no whitespace in the label section and after the label colon
- * - one space between the command and the arguments
- * - no whitespace between the arguments
- *
- * Args:
- * s - the string to clean
- *
- * Return:
- * The clean string
- */
-char *clean_str(char *s);
-
 /*
  * Build the name of the entries file (.ent)
  *
@@ -0,0 +1,217 @@
+/*
+ * Buffered output files
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include "errors.h"
+#include "writer.h"
+#include "context.h"
+
+/*
+ * Make room for <n> more characters in the buffer of a writer:
+ * flush a file writer, grow an in-memory writer
+ */
+static void make_room(Writer *w, size_t n){
+    char *new_buf;
+    size_t new_size;
+
+    if (w->len + n <= w->size)
+        return;
+
+    if (w->fp != NULL){
+        flush_writer(w);
+        return;
+    }
+
+    for (new_size = w->size; w->len + n > new_size; new_size *= 2) {}
+    new_buf = (char *) realloc(w->buf, new_size);
+    if (new_buf == NULL)
+        raise_error("Internal error: out of memory.");
+
+    w->buf = new_buf;
+    w->size = new_size;
+}
+
+/*
+ * Allocate a writer and its buffer, with no file yet
+ *
+ * Args:
+ * fname - Name of the file the writer is for, copied into the writer (NULL if it has none)
+ */
+static Writer *alloc_writer(char *fname){
+    Writer *w;
+
+    w = (Writer *) calloc(1, sizeof(Writer));
+    if (w == NULL)
+        raise_error("Internal error: out of memory.");
+
+    w->size = WRITER_BUFFER_SIZE;
+    w->buf = (char *) malloc(w->size);
+    if (fname != NULL){
+        w->fname = (char *) malloc(strlen(fname) + 1);
+        if (w->fname != NULL)
+            strcpy(w->fname, fname);
+    }
+    if (w->buf == NULL || (fname != NULL && w->fname == NULL)){
+        free(w->buf);
+        free(w->fname);
+        free(w);
+        raise_error("Internal error: out of memory.");
+    }
+    return w;
+}
+
+/*
+ * Free a writer, its buffer and its name (the file is not closed)
+ */
+static void free_writer(Writer *w){
+    free(w->fname);
+    free(w->buf);
+    free(w);
+}
+
+/*
+ * Report that the file of a writer didn't take the data written to it
+ */
+static void report_write_error(Writer *w){
+    report("[x] Cannot write to output file %s\n", w->fname != NULL ? w->fname : "(temporary file)");
+}
+
+Writer *create_writer(char *fname){
+    Writer *w;
+
+    w = alloc_writer(fname);
+    if (fname == NULL)
+        return w;
+
+    w->fp = ctx_fopen(fname, "w");
+    if (w->fp == NULL){
+        free_writer(w);
+        report("[x] Cannot create output file %s\n", fname);
+        raise_error(NULL);
+    }
+
+    /* The writer has its own buffer, don't let stdio copy the data a second time */
+    setvbuf(w->fp, NULL, _IONBF, 0);
+
+    return w;
+}
+
+Writer *create_temp_writer(){
+    Writer *w;
+
+    w = alloc_writer(NULL);
+
+    /* The file is unlinked from the start (O_TMPFILE where the system has it), closing it removes it */
+    w->fp = tmpfile();
+    if (w->fp == NULL){
+        free_writer(w);
+        raise_error("Internal error: cannot create a temporary file.");
+    }
+    setvbuf(w->fp, NULL, _IONBF, 0);
+
+    return w;
+}
+
+void write_to_writer(Writer *w, char *s, size_t n){
+    /* Big writes go straight to the file */
+    if (n >= WRITER_BUFFER_SIZE && w->fp != NULL){
+        flush_writer(w);
+        if (fwrite(s, 1, n, w->fp) != n){
+            report_write_error(w);
+            raise_error(NULL);
+        }
+        return;
+    }
+
+    make_room(w, n);
+    memcpy(w->buf + w->len, s, n);
+    w->len += n;
+}
+
+char *reserve_in_writer(Writer *w, size_t n){
+    make_room(w, n);
+    return w->buf + w->len;
+}
+
+void advance_writer(Writer *w, size_t n){
+    w->len += n;
+}
+
+/*
+ * Write the whole buffer of a writer to its file
+ *
+ * Return:
+ * False if the file didn't take all of it
+ */
+static bool write_buffer(Writer *w){
+    /* An in-memory writer keeps everything */
+    if (w->len == 0 || w->fp == NULL)
+        return true;
+
+    if (fwrite(w->buf, 1, w->len, w->fp) != w->len)
+        return false;
+
+    w->len = 0;
+    return true;
+}
+
+void flush_writer(Writer *w){
+    if (!write_buffer(w)){
+        report_write_error(w);
+        raise_error(NULL);
+    }
+}
+
+void close_writer(Writer *w){
+    bool written;
+
+    if (w == NULL)
+        return;
+
+    /* The writer is freed even if the file fails, a full disk may only show once the file is closed */
+    written = write_buffer(w);
+    if (w->fp != NULL && fclose(w->fp) != 0)
+        written = false;
+    if (!written)
+        report_write_error(w);
+    free_writer(w);
+
+    if (!written)
+        raise_error(NULL);
+}
+
+void discard_writer(Writer *w){
+    if (w == NULL)
+        return;
+
+    /* A failed file leaves an empty output, even if a part of it was flushed already */
+    if (w->fp != NULL){
+        if (ftruncate(fileno(w->fp), 0) != 0){
+            /*
+             * Nothing else can be done: the assembling of the file already failed and its error is reported,
+             * the partial output is only left as it is (ftruncate warns if its result is not checked)
+             */
+        }
+        fclose(w->fp);
+    }
+    free_writer(w);
+}
+
+char *take_writer_buffer(Writer *w, size_t *len){
+    char *buf;
+
+    make_room(w, 1);
+    w->buf[w->len] = '\0';
+
+    buf = w->buf;
+    *len = w->len;
+    free(w->fname);
+    free(w);
+    return buf;
+}
@@ -0,0 +1,124 @@
+/*
+ * Buffered output files
+ * The data is accumulated in memory and written to the file in big chunks
+ * A writer without a file keeps everything in memory (see take_writer_buffer)
+ */
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stdio.h>
+
+#define WRITER_BUFFER_SIZE 262144
+
+/*
+ * Represent an output file opened for the whole assembling of a source file
+ *
+ * Attributes:
+ * fname - Name of the file (for the error messages), NULL for a temporary or an in-memory writer
+ * fp - The underlying (unbuffered) stream, NULL for an in-memory writer
+ * buf - Data waiting to be written (the whole output for an in-memory writer)
+ * len - Number of characters in <buf>
+ * size - Number of allocated characters in <buf>
+ */
+typedef struct Writer{
+	char *fname;
+	FILE *fp;
+	char *buf;
+	size_t len;
+	size_t size;
+} Writer;
+
+/*
+ * Create (or truncate) a file and open a writer on it
+ * An error is raised if the file cannot be created
+ *
+ * Args:
+ * fname - Name of the file, NULL for an in-memory writer whose buffer grows instead of being flushed
+ *
+ * Return:
+ * The writer
+ */
+Writer *create_writer(char *fname);
+
+/*
+ * Open a writer on a temporary file that has no name, the file is removed once the writer is closed
+ * Once flushed, the file can be read back through <fp>
+ * An error is raised if the file cannot be created
+ *
+ * Return:
+ * The writer
+ */
+Writer *create_temp_writer();
+
+/*
+ * Append characters to a writer, the buffer is flushed when it is full
+ *
+ * Args:
+ * w - The writer
+ * s - Characters to write
+ * n - Number of characters to write
+ */
+void write_to_writer(Writer *w, char *s, size_t n);
+
+/*
+ * Get free space at the end of the buffer of a writer, the buffer is flushed if needed
+ * The characters written there are only added to the file once passed to advance_writer
+ *
+ * Args:
+ * w - The writer
+ * n - Number of characters needed (at most WRITER_BUFFER_SIZE)
+ *
+ * Return:
+ * Pointer where <n> characters can be written
+ */
+char *reserve_in_writer(Writer *w, size_t n);
+
+/*
+ * Add characters written in the space given by reserve_in_writer to a writer
+ *
+ * Args:
+ * w - The writer
+ * n - Number of characters written
+ */
+void advance_writer(Writer *w, size_t n);
+
+/*
+ * Write the whole buffer of a writer to its file
+ *
+ * Args:
+ * w - The writer
+ */
+void flush_writer(Writer *w);
+
+/*
+ * Flush a writer, close its file and free it
+ * The writer is freed even if the file cannot be written, then an error is raised: stop tracking
+ * the writer (see context.h) before closing it
+ *
+ * Args:
+ * w - The writer
+ */
+void close_writer(Writer *w);
+
+/*
+ * Close a writer and free it, without writing what is left in its buffer (used when the assembling fails)
+ * What was already written to the file is dropped too, the file is left empty
+ *
+ * Args:
+ * w - The writer, nothing is done if NULL
+ */
+void discard_writer(Writer *w);
+
+/*
+ * Free an in-memory writer and hand over its buffer
+ *
+ * Args:
+ * w - The writer
+ * len - Where the number of written characters is written
+ *
+ * Return:
+ * Everything written to the writer, null terminated (to free)
+ */
+char *take_writer_buffer(Writer *w, size_t *len);
+
+#endif